@@ -16,6 +16,7 @@
 #include "mumlib2/enums.h"
 #include "mumlib2/export.h"
 #include "mumlib2/exceptions.h"
+#include "mumlib2/host.h"
 #include "mumlib2/logger.h"
 #include "mumlib2/structs.h"
 
@@ -31,16 +32,54 @@ namespace mumlib2 {
 
         explicit Mumlib2(Callback &callback);
 
+        // attaches the connection to a shared host, run() is not needed then
+        Mumlib2(Callback &callback, Mumlib2Host &host);
+
         virtual ~Mumlib2();
 
         //acl
         bool AclSetTokens(const std::vector<std::string>& tokens);
 
+        //audio
+        void AudioFlush(uint32_t target = 0);
+        void AudioSetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet = 1);
+        void AudioSetEncoderProfile(const AudioEncoderProfile& profile);
+        AudioEncoderProfile AudioGetEncoderProfile();
+        void AudioSetSamplerate(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t quality = MUMBLE_RESAMPLER_QUALITY);
+        void AudioSetFec(bool enabled);
+        void AudioSetVadConfig(const AudioVadConfig& config);
+        AudioVadStats AudioGetVadStats();
+        void AudioSetDecoderThreads(uint32_t threads);
+        void AudioSetJitterConfig(const JitterBufferConfig& config);
+        std::vector<JitterBufferStats> AudioGetJitterStats();
+        void AudioSetMixerConfig(const AudioMixerConfig& config);
+        void AudioSetSpeakerGain(int32_t session_id, float gain);
+
+        // queues the PCM of sendAudioData() for the encoder instead of encoding
+        // and sending on the calling thread; refused (false) unless disconnected,
+        // and not to be called while sendAudioData() runs. With an input,
+        // sendAudioData() and AudioFlush() must be called from the same
+        // (capture) thread
+        bool AudioSetInputConfig(const AudioInputConfig& config);
+        AudioInputStats AudioGetInputStats();
+
+        // pull based output, refused (false) unless disconnected, and not to be
+        // called while AudioOutputPop() runs; a single thread may drain the
+        // queue, AudioOutputPop() never blocks
+        bool AudioSetOutputConfig(const AudioOutputConfig& config);
+        bool AudioOutputPop(AudioOutputFrame& frame);
+        AudioOutputStats AudioGetOutputStats();
+
         //channel
         std::string ChannelCurrentGetName();
         int32_t ChannelCurrentGetId();
         bool ChannelJoin(const std::string& channel_name);
         bool ChannelJoin(int channel_id);
+        std::optional<MumbleChannel> ChannelGet(int32_t channel_id);
+        std::vector<MumbleChannel> ChannelGetChildren(int32_t channel_id);
+
+        // by name or by path from the root channel ("Lobby/Team"), -1 if unknown
+        int32_t ChannelFind(const std::string& name_or_path);
 
         //user
         std::optional<MumbleUser> UserGet(int32_t session_id);
@@ -51,6 +90,10 @@ namespace mumlib2 {
         bool UserMute(const std::string& user_name, bool mute_state);
         bool UserMute(int32_t user_id, bool mute_state);
 
+        // fetches the COMMENT and/or TEXTURE of a user announced by hash,
+        // delivered through Callback::userBlob()
+        bool UserRequestBlob(int32_t user_id, UserField fields);
+
         //
         bool connect(string host, int port, string user, string password);
 
@@ -60,6 +103,8 @@ namespace mumlib2 {
 
         ConnectionState getConnectionState();
 
+        ConnectionStats StatsGet();
+
         vector<MumbleUser> getListAllUser();
 
         vector<MumbleChannel> getListAllChannel();
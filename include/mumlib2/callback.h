@@ -10,6 +10,8 @@
 
 //mumlib2
 #include "mumlib2/Export.h"
+#include "mumlib2/enums.h"
+#include "mumlib2/structs.h"
 
 namespace mumlib2 {
 
@@ -33,6 +35,24 @@ namespace mumlib2 {
                 const int16_t* audio_buf,
                 size_t samples_count) { };
 
+        // audio synthesized for a lost voice packet (packet loss concealment or
+        // in-band FEC), forwarded to audio() unless overridden
+        virtual void audioConcealed(
+                int target,
+                int sessionId,
+                int sequenceNumber,
+                const int16_t* audio_buf,
+                size_t samples_count) {
+            audio(target, sessionId, sequenceNumber, false, audio_buf, samples_count);
+        };
+
+        // all speakers of a channel mixed into one stream, see Mumlib2::AudioSetMixerConfig()
+        virtual void audioMixed(
+                int32_t channel_id,
+                uint32_t speakers_count,
+                const int16_t* audio_buf,
+                size_t samples_count) { };
+
         virtual void unsupportedAudio(
                 int target,
                 int sessionId,
@@ -80,6 +100,25 @@ namespace mumlib2 {
                 int32_t priority_speaker,
                 int32_t recording) { };
 
+        // user state after merging a UserState message, `fields` are the ones
+        // that changed (CREATED for a new user); called after userState()
+        virtual void userChanged(
+                const MumbleUser& user,
+                UserField fields) { };
+
+        // comment or texture content, sent inline by the server or as answer
+        // to Mumlib2::UserRequestBlob()
+        virtual void userBlob(
+                int32_t session,
+                UserField field,
+                const string& data) { };
+
+        // user joined (channel_from is -1) or changed channel, called after userChanged()
+        virtual void userMoved(
+                int32_t session,
+                int32_t channel_from,
+                int32_t channel_to) { };
+
         virtual void banList(
                 const uint8_t *ip_data,
                 uint32_t ip_data_size,
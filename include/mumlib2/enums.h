@@ -63,11 +63,65 @@ namespace mumlib2 {
         RECORDING
     };
 
+    // fields of a MumbleUser, combined as bitmask in Callback::userChanged()
+    enum class UserField : uint32_t {
+        NONE             = 0,
+        CREATED          = 1u << 0,
+        NAME             = 1u << 1,
+        CHANNEL          = 1u << 2,
+        USER_ID          = 1u << 3,
+        MUTE             = 1u << 4,
+        DEAF             = 1u << 5,
+        SUPPRESS         = 1u << 6,
+        SELF_MUTE        = 1u << 7,
+        SELF_DEAF        = 1u << 8,
+        PRIORITY_SPEAKER = 1u << 9,
+        RECORDING        = 1u << 10,
+        HASH             = 1u << 11,
+        COMMENT          = 1u << 12,
+        TEXTURE          = 1u << 13
+    };
+
+    constexpr UserField operator|(UserField a, UserField b)
+    {
+        return static_cast<UserField>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+    }
+
+    constexpr UserField operator&(UserField a, UserField b)
+    {
+        return static_cast<UserField>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+    }
+
+    constexpr UserField& operator|=(UserField& a, UserField b)
+    {
+        return a = a | b;
+    }
+
     enum class VoiceTargetType {
         CHANNEL,
         USER
     };
 
+    enum class AudioApplication {
+        VOIP,
+        AUDIO,
+        RESTRICTED_LOWDELAY
+    };
+
+    enum class AudioBandwidth {
+        NARROWBAND,
+        MEDIUMBAND,
+        WIDEBAND,
+        SUPERWIDEBAND,
+        FULLBAND
+    };
+
+    enum class AudioBitrateMode {
+        CBR,
+        VBR,
+        CVBR
+    };
+
     enum class PingState {
         PING,
         PONG,
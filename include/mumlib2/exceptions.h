@@ -28,6 +28,11 @@ namespace mumlib2 {
         explicit AudioPacketException(std::string message) : Mumlib2Exception(message) { }
     };
 
+    class AudioResamplerException : public Mumlib2Exception {
+    public:
+        explicit AudioResamplerException(std::string message) : Mumlib2Exception(message) { }
+    };
+
     class TransportException : public Mumlib2Exception {
     public:
         TransportException(std::string message) : Mumlib2Exception(std::move(message)) { }
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//mumlib
+#include "mumlib2/export.h"
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    class Mumlib2HostPrivate;
+
+    /*
+     * Shared I/O context for many Mumlib2 connections. The host owns a pool of
+     * threads which drive all attached connections, each connection runs on its
+     * own strand. Mumlib2::run() is not needed for attached connections.
+     *
+     * All attached Mumlib2 instances must be destroyed before the host.
+     */
+    class MUMLIB2_EXPORT Mumlib2Host {
+    public:
+        //mark as non-copyable
+        Mumlib2Host(const Mumlib2Host&) = delete;
+        Mumlib2Host& operator=(const Mumlib2Host&) = delete;
+
+        //ctor/dtor
+        // thread_count = 0 uses one thread per hardware thread
+        explicit Mumlib2Host(size_t thread_count = 0);
+        ~Mumlib2Host();
+
+        [[nodiscard]] size_t ThreadCount() const;
+        [[nodiscard]] size_t ConnectionCount() const;
+
+        //stats
+        [[nodiscard]] std::vector<ConnectionStats> StatsGet() const;
+        [[nodiscard]] HostStats StatsGetAggregate() const;
+
+    private:
+        friend class Mumlib2;
+
+        std::unique_ptr<Mumlib2HostPrivate> impl;
+    };
+}
@@ -4,8 +4,14 @@
 #pragma once
 
 //stdlib
+#include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
+
+//mumlib
+#include "mumlib2/constants.h"
+#include "mumlib2/enums.h"
 
 namespace mumlib2 {
     struct MumbleUser {
@@ -14,11 +20,195 @@ namespace mumlib2 {
         std::string name = "";
 
         bool local_mute = false;
+
+        int32_t userId = -1; //registered user id, -1 if not registered
+        bool mute = false;
+        bool deaf = false;
+        bool suppress = false;
+        bool self_mute = false;
+        bool self_deaf = false;
+        bool priority_speaker = false;
+        bool recording = false;
+        std::string hash = ""; //certificate hash
+
+        //comment and texture are not stored, only the SHA1 of their content
+        //(empty if there is none); fetch them with Mumlib2::UserRequestBlob()
+        std::string comment_hash = "";
+        std::string texture_hash = "";
     };
 
     struct MumbleChannel {
         int32_t channelId = -1;
         std::string name = "";
         std::string description = "";
+
+        int32_t parent = -1; //-1 for the root channel
+        std::vector<uint32_t> links; //sorted channel ids
+        bool temporary = false;
+        int32_t position = 0;
+    };
+
+    struct ConnectionStats {
+        ConnectionState state = ConnectionState::NOT_CONNECTED;
+        bool udp_active = false;
+
+        //control channel
+        uint64_t tcp_messages = 0;
+        uint64_t tcp_rejected = 0;
+        uint64_t tcp_queued_bytes = 0;
+
+        //voice channel
+        uint64_t udp_sent = 0;
+        uint64_t udp_dropped = 0;
+        uint32_t udp_good = 0;
+        uint32_t udp_late = 0;
+        uint32_t udp_lost = 0;
+        uint32_t udp_resync = 0;
+    };
+
+    struct HostStats {
+        uint32_t threads = 0;
+        uint32_t connections = 0;
+        uint32_t connected = 0;
+        uint32_t udp_active = 0;
+
+        // counters summed over all attached connections
+        ConnectionStats total;
+    };
+
+    struct AudioEncoderProfile {
+        // upper bound, lowered to fit the server's max_bandwidth including packet overhead
+        // and to keep each packet within one UDP datagram
+        uint32_t bitrate = MUMBLE_OPUS_BITRATE;
+        AudioBitrateMode bitrate_mode = AudioBitrateMode::CBR;
+
+        // 0 (fastest) to 10 (best quality)
+        uint32_t complexity = 10;
+
+        AudioApplication application = AudioApplication::VOIP;
+        AudioBandwidth max_bandwidth = AudioBandwidth::FULLBAND;
+
+        // discontinuous transmission, silence is sent at a very low rate
+        bool dtx = false;
+
+        // 1 or 2, the PCM passed to the send functions is interleaved
+        uint32_t channels = MUMBLE_AUDIO_CHANNELS;
+    };
+
+    struct AudioVadConfig {
+        bool enabled = false;
+
+        // frames below this level (dBFS) are always silence
+        float threshold_db = -50.0f;
+
+        // frames have to exceed the tracked noise floor by this much (dB)
+        float margin_db = 9.0f;
+
+        // talking continues this long after the last voiced frame
+        uint32_t hangover_ms = 300;
+    };
+
+    struct AudioVadStats {
+        bool talking = false;
+
+        uint64_t frames_talk = 0;
+        uint64_t frames_silent = 0;   // not encoded and not sent
+        uint64_t talk_spurts = 0;
+        float noise_floor_db = 0.0f;
+    };
+
+    struct JitterBufferConfig {
+        bool enabled = true;
+
+        // percentile of the measured inter-arrival jitter covered by the playout delay
+        uint32_t percentile = 95;
+
+        uint32_t delay_min_ms = 20;
+        uint32_t delay_max_ms = 200;
+    };
+
+    struct AudioMixerConfig {
+        bool enabled = false;
+
+        // mixed audio is delivered every 10 or 20 ms
+        uint32_t period_ms = 20;
+
+        // compress peaks instead of hard clipping the sum
+        bool limiter = true;
+    };
+
+    struct AudioInputConfig {
+        bool enabled = false;
+
+        // capacity of the capture queue, PCM is split into chunks of at most chunk_ms
+        uint32_t chunks = 32;
+        uint32_t chunk_ms = 20;
+
+        // interval in which the encoder drains the queue
+        uint32_t poll_ms = 5;
+    };
+
+    struct AudioInputStats {
+        uint64_t pushed = 0;        // chunks queued by the capture thread
+        uint64_t dropped = 0;       // chunks lost because the queue was full
+        uint64_t encoded = 0;       // chunks consumed by the encoder
+        uint64_t failed = 0;        // chunks the encoder failed on, included in encoded
+        uint32_t depth = 0;
+
+        // time spent in the capture thread per send call
+        uint64_t push_ns_max = 0;
+        uint64_t push_ns_avg = 0;
+    };
+
+    struct AudioOutputConfig {
+        bool enabled = false;
+
+        // capacity of the output queue in frames
+        uint32_t frames = 128;
+
+        // deliver through the Callback as well
+        bool callback = false;
+    };
+
+    struct AudioOutputFrame {
+        int32_t session_id = -1;    // -1 for mixed audio
+        int32_t channel_id = -1;    // mixed audio only
+        uint32_t speakers = 0;      // mixed audio only
+        uint8_t target = 0;
+        int64_t sequence_number = 0;
+        bool is_last = false;
+        bool is_concealed = false;
+
+        // when the frame was decoded or mixed
+        std::chrono::steady_clock::time_point timestamp;
+
+        // interleaved, `samples` per channel; the buffer is swapped with the
+        // queue, reusing the same frame for every pop avoids allocations
+        std::vector<int16_t> pcm;
+        size_t samples = 0;
+    };
+
+    struct AudioOutputStats {
+        uint64_t pushed = 0;
+        uint64_t popped = 0;
+        uint64_t overflows = 0;     // frames dropped because the queue was full
+        uint64_t underflows = 0;    // pops from the empty queue
+        uint32_t depth = 0;
+    };
+
+    struct JitterBufferStats {
+        int32_t session_id = -1;
+        uint32_t depth_ms = 0;
+        uint32_t target_ms = 0;
+
+        uint64_t received = 0;
+        uint64_t played = 0;
+        uint64_t late = 0;      // arrived after their playout time
+        uint64_t lost = 0;      // never arrived
+        uint64_t dropped = 0;   // duplicates and frames skipped to shrink the buffer
+        uint64_t underruns = 0;
+
+        uint64_t concealed = 0; // lost frames replaced by PLC or FEC
+        uint64_t fec = 0;       // of which were rebuilt from in-band FEC data
     };
 }
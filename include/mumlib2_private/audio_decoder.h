@@ -6,18 +6,46 @@
 //stdlib
 #include <chrono>
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 //opus
 #include <opus/opus.h>
 
 //mumlib
+#include "mumlib2/constants.h"
 #include "mumlib2/logger.h"
+#include "mumlib2/structs.h"
 #include "mumlib2_private/audio_decoder_session.h"
-#include "mumlib2_private/audio_packet.h"
+#include "mumlib2_private/audio_decoder_workers.h"
+#include "mumlib2_private/audio_mixer.h"
+#include "mumlib2_private/audio_packet_view.h"
+#include "mumlib2_private/spsc_queue.h"
 
 namespace mumlib2 {
+
+    /*
+     * Decodes the voice of all speakers, one AudioDecoderSession each.
+     *
+     * Sessions are kept in a dense list and found through an index addressed by
+     * the session id (Mumble hands out small ids), larger ids fall back to a
+     * hash map. Idle sessions are evicted by Evict() from a periodic timer, not
+     * on the packet path; released sessions are kept in a small pool and reused
+     * with their Opus decoder reset instead of recreated.
+     *
+     * With decoder threads enabled, speakers are sharded by session id over the
+     * workers. Each Tick() runs the shards in parallel; decoded frames come back
+     * through one SPSC queue per worker and are delivered on the calling thread
+     * while the workers continue, so the order per speaker is kept. Packets
+     * bypassing the jitter buffer are queued and decoded on the next Tick().
+     *
+     * Decoded and mixed frames are copied aside and handed to the sinks after
+     * the lock is released, so the callbacks may call the settings and stats
+     * accessors.
+     */
     class AudioDecoder {
     public:
         //mark as non-copyable
@@ -25,18 +53,126 @@ namespace mumlib2 {
         AudioDecoder& operator=(const AudioDecoder&) = delete;
         
         //ctor/dtor
-        explicit AudioDecoder(uint32_t channels);
+        AudioDecoder(uint32_t channels, uint32_t samplerate);
         ~AudioDecoder();
 
-        std::pair<const int16_t*, size_t> Process(const AudioPacket& packet);
+        // decodes the packet, or queues it in the speaker's jitter buffer if enabled;
+        // returns true if Tick() has to be called
+        bool Process(const AudioPacketView& packet, const AudioDecoderSink& sink);
+
+        // plays out one jitter buffer tick (AudioJitterBuffer::TickMs) of all
+        // speakers and advances the mixer, returns false once everything is idle
+        bool Tick(const AudioDecoderSink& sink, const AudioMixerSink& mix_sink);
+
+        // releases the sessions idle for longer than the inactivity timeout
+        void Evict();
+
+        // releases the speaker's session, e.g. once the user left the server
+        void Release(int32_t session_id);
+
+        // number of decoder threads, 0 decodes on the calling thread
+        void SetWorkers(uint32_t count);
+
+        void SetJitterConfig(const JitterBufferConfig& config);
+        [[nodiscard]] std::vector<JitterBufferStats> GetJitterStats() const;
+
+        // samplerate of the delivered PCM, resampled from MUMBLE_AUDIO_SAMPLERATE
+        void SetOutputSamplerate(uint32_t samplerate, uint32_t quality);
+
+        // `channel_function` maps a speaker's session to the channel it is mixed into
+        void SetMixerConfig(const AudioMixerConfig& config, std::function<int32_t(int32_t)> channel_function);
+        void SetMixerGain(int32_t session_id, float gain);
+
+    private:
+        AudioDecoderSession& acquire(int32_t session_id);
+        void release(size_t position);
+
+        // position in _sessions plus one, 0 if absent
+        [[nodiscard]] size_t locate(int32_t session_id) const;
+        void index(int32_t session_id, size_t position);
+
+        AudioDecoderSink mixSink(const AudioDecoderSink& sink);
+
+        // collect frames under _mutex, deliver them once it is released
+        AudioDecoderSink pendingSink();
+        AudioMixerSink pendingMixSink();
+        void pendingDeliver(const AudioDecoderSink& sink, const AudioMixerSink* mix_sink);
+
+        //workers
+        void workerQueue(int32_t session_id, const AudioPacketView& packet, const AudioDecoderSink& sink);
+        bool workerRun(const AudioDecoderSink& sink);
+        void workerJob(size_t worker);
+        bool workerDrain(const AudioDecoderSink& sink);
+
+    private:
+        // packet waiting for a worker, copied out of the receive buffer
+        struct WorkerPacket {
+            int32_t session_id = 0;
+            uint8_t target = 0;
+            int64_t sequence = 0;
+            bool is_last = false;
+            std::vector<uint8_t> payload;
+        };
+
+        // decoded frame on its way back, `frame.pcm` is restored from `pcm`
+        struct PendingFrame {
+            AudioDecoderFrame frame;
+            std::vector<int16_t> pcm;
+        };
+
+        struct PendingMix {
+            AudioMixerFrame frame;
+            std::vector<int16_t> pcm;
+        };
+
+        struct WorkerShard {
+            SpscQueue<WorkerPacket> packets = SpscQueue<WorkerPacket>(_worker_packets_max);
+            SpscQueue<PendingFrame> frames = SpscQueue<PendingFrame>(_worker_frames_max);
+            bool active = false;
+        };
 
     private:
         Logger _logger = Logger("mumlib/AudioDecoder");
 
+        // Process()/Tick() run on the transport strand, the settings and stats
+        // accessors are called from the user
+        mutable std::mutex _mutex;
+        JitterBufferConfig _jitter_config;
+
+        AudioMixer _mixer;
+        std::function<int32_t(int32_t)> _mixer_channel_function;
+
         uint32_t _channels = 0;
+        uint32_t _samplerate = 0;
+        uint32_t _resampler_quality = MUMBLE_RESAMPLER_QUALITY;
 
         const std::chrono::seconds _timeout_inactivity = std::chrono::seconds(300);
 
-        std::map<int32_t, std::unique_ptr<AudioDecoderSession>> _sessions;
+        std::vector<std::unique_ptr<AudioDecoderSession>> _sessions;
+        std::vector<size_t> _sessions_index;
+        std::unordered_map<int32_t, size_t> _sessions_index_sparse;
+
+        //frames waiting for delivery, only used on the transport strand;
+        //the slots keep their capacity
+        std::vector<PendingFrame> _pending_frames;
+        size_t _pending_frames_count = 0;
+        std::vector<PendingMix> _pending_mixes;
+        size_t _pending_mixes_count = 0;
+
+        //released sessions, reused for the next speaker
+        std::vector<std::unique_ptr<AudioDecoderSession>> _pool;
+
+        //decoder threads, shard i serves the sessions with id % count == i
+        std::unique_ptr<AudioDecoderWorkers> _workers;
+        std::vector<std::unique_ptr<WorkerShard>> _worker_shards;
+
+    private:
+        // session ids below are indexed directly
+        static constexpr int32_t _sessions_indexed_max = 4096;
+
+        static constexpr size_t _pool_max = 16;
+
+        static constexpr size_t _worker_packets_max = 256;
+        static constexpr size_t _worker_frames_max = 64;
     };
 }
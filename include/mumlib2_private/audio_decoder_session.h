@@ -6,7 +6,9 @@
 //stdlib
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 //opus
@@ -14,9 +16,28 @@
 
 //mumlib
 #include "mumlib2/logger.h"
-#include "mumlib2_private/audio_packet.h"
+#include "mumlib2/structs.h"
+#include "mumlib2_private/audio_jitter_buffer.h"
+#include "mumlib2_private/audio_packet_view.h"
+#include "mumlib2_private/audio_resampler.h"
 
 namespace mumlib2 {
+
+    struct AudioDecoderFrame {
+        uint8_t target = 0;
+        int32_t session_id = 0;
+        int64_t sequence_number = 0;
+        bool is_last = false;
+
+        // lost frame replaced by packet loss concealment or in-band FEC
+        bool is_concealed = false;
+
+        const int16_t* pcm = nullptr;
+        size_t samples = 0;
+    };
+
+    using AudioDecoderSink = std::function<void(const AudioDecoderFrame&)>;
+
     class AudioDecoderSession {
     public:
         //mark as non-copyable
@@ -24,16 +45,43 @@ namespace mumlib2 {
         AudioDecoderSession& operator=(const AudioDecoderSession&) = delete;
         
         //ctor/dtor
-        explicit AudioDecoderSession(int32_t session_id, uint32_t channels);
+        AudioDecoderSession(int32_t session_id, uint32_t channels, uint32_t samplerate, uint32_t resampler_quality,
+                            const JitterBufferConfig& jitter_config);
         ~AudioDecoderSession();
 
-        std::pair<const int16_t*, size_t> Process(const AudioPacket& packet);
+        // decodes the packet right away, bypassing the jitter buffer
+        void Process(const AudioPacketView& packet, const AudioDecoderSink& sink);
+        void Process(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, const AudioDecoderSink& sink);
+
+        // queues the packet in the jitter buffer, it is decoded by Tick()
+        void Push(const AudioPacketView& packet);
+
+        // plays out one jitter buffer tick, returns false once the buffer is idle
+        bool Tick(const AudioDecoderSink& sink);
+
+        void SetJitterConfig(const JitterBufferConfig& config);
+        [[nodiscard]] JitterBufferStats GetJitterStats() const;
+
+        // output other than MUMBLE_AUDIO_SAMPLERATE is resampled after decoding
+        void SetOutputSamplerate(uint32_t samplerate, uint32_t quality);
 
+        // returns the session to its initial state for another speaker, the
+        // Opus decoder is reset instead of being recreated
+        void Recycle(int32_t session_id);
+
+        [[nodiscard]] int32_t GetSessionId() const;
         std::chrono::time_point<std::chrono::steady_clock> GetLastTimepoint();
 
     private:
+        void decode(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, const AudioDecoderSink& sink);
+
+        // synthesizes a lost frame, from the FEC data of `next` if given, otherwise by PLC
+        void conceal(uint8_t target, int64_t sequence, uint32_t units, std::span<const uint8_t> next, const AudioDecoderSink& sink);
+
+        void emit(AudioDecoderFrame& frame, const AudioDecoderSink& sink);
+
         void opusCreate();
-        size_t opusDecode(const uint8_t* in_data, size_t in_len);
+        int opusDecode(const uint8_t* in_data, size_t in_len, size_t frame_size, bool fec);
         void opusDestroy();
         void opusResize();
 
@@ -45,9 +93,27 @@ namespace mumlib2 {
         OpusDecoder* _opus = nullptr;
         std::vector<int16_t> _opus_output_buf;
 
+        AudioJitterBuffer _jitter;
+
+        //output conversion, absent at MUMBLE_AUDIO_SAMPLERATE
+        std::unique_ptr<AudioResampler> _resampler;
+        std::vector<int16_t> _resampler_buf;
+
         uint32_t _channels = 0;
         int32_t _session_id;
 
+        //gap detection, in sequence units
+        int64_t _sequence_next = -1;
+        uint32_t _frame_units = 2;
+        uint8_t _target_last = 0;
+
+        uint64_t _stats_concealed = 0;
+        uint64_t _stats_fec = 0;
+
         std::chrono::time_point<std::chrono::steady_clock> _timepoint_last;
+
+    private:
+        // longer gaps are treated as a new stream instead of being concealed
+        static constexpr int64_t _conceal_max_units = 10;
     };
 }
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//mumlib
+#include "mumlib2/logger.h"
+
+namespace mumlib2 {
+
+    /*
+     * Fixed set of decoder threads driven in lockstep by the caller.
+     *
+     * Run() hands the same job to every worker, each one is told its index and
+     * processes its own shard of the speakers. The calling thread keeps polling
+     * for results while the workers are busy and returns once all finished.
+     */
+    class AudioDecoderWorkers {
+    public:
+        //mark as non-copyable
+        AudioDecoderWorkers(const AudioDecoderWorkers&) = delete;
+        AudioDecoderWorkers& operator=(const AudioDecoderWorkers&) = delete;
+
+        //ctor/dtor
+        explicit AudioDecoderWorkers(size_t count);
+        ~AudioDecoderWorkers();
+
+        // runs `job` on all workers; `poll` is called on the calling thread until
+        // they are done and then until it returns false (nothing left to do)
+        void Run(const std::function<void(size_t worker)>& job, const std::function<bool()>& poll);
+
+        [[nodiscard]] size_t GetCount() const;
+
+    private:
+        void threadRun(size_t worker);
+
+    private:
+        Logger _logger = Logger("mumlib/AudioDecoderWorkers");
+
+        std::vector<std::thread> _threads;
+
+        //job of the current generation, set before the generation is advanced
+        const std::function<void(size_t)>* _job = nullptr;
+        std::atomic<uint64_t> _generation = 0;
+        std::atomic<size_t> _pending = 0;
+        std::atomic<bool> _stop = false;
+    };
+}
@@ -6,17 +6,27 @@
 //stdlib
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 //opus
 #include <opus/opus.h>
 
 //mumlib
+#include "mumlib2/constants.h"
 #include "mumlib2/logger.h"
+#include "mumlib2/structs.h"
 #include "mumlib2_private/audio_packet.h"
+#include "mumlib2_private/audio_resampler.h"
+#include "mumlib2_private/audio_vad.h"
 
 namespace mumlib2 {
+
+    // receives a complete voice packet, it points into the caller's output buffer
+    using AudioEncoderSink = std::function<void(std::span<const uint8_t> packet)>;
+
     class AudioEncoder {
     public:
         //mark as non-copyable
@@ -24,32 +34,104 @@ namespace mumlib2 {
         AudioEncoder& operator=(const AudioEncoder&) = delete;
         
         //ctor/dtor
-        explicit AudioEncoder(uint32_t output_bitrate);
+        AudioEncoder(uint32_t input_samplerate, const AudioEncoderProfile& profile);
         ~AudioEncoder();
 
-        std::vector<uint8_t> Encode(const int16_t* pcmData, size_t pcmLength, uint32_t target);
+        // accumulates PCM of any length (samples per channel at the input samplerate) and emits a voice packet,
+        // written to `out`, whenever a packet worth of frames has been encoded
+        void Encode(const int16_t* pcmData, size_t pcmLength, uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink);
+
+        // encodes the buffered remainder padded with silence and ends the talk spurt
+        // with the terminator flag
+        void Flush(uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink);
 
+        // applies all encoder settings; changing the channels or the application
+        // recreates the encoder and starts a new stream
+        void SetProfile(const AudioEncoderProfile& profile);
+        [[nodiscard]] const AudioEncoderProfile& GetProfile() const;
+
+        // limited to what still fits the packet into one UDP datagram
         void SetBitrate(uint32_t bitrate);
 
+        // input other than MUMBLE_AUDIO_SAMPLERATE is resampled before encoding
+        void SetInputSamplerate(uint32_t samplerate, uint32_t quality);
+        [[nodiscard]] uint32_t GetInputSamplerate() const;
+
+        // frame duration of 10, 20, 40 or 60 ms, several frames may be packed into
+        // one packet as long as it does not exceed MUMBLE_OPUS_MAXLENGTH
+        void SetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet);
+        [[nodiscard]] uint32_t GetPacketDuration() const;
+
+        // in-band forward error correction, tuned by the expected packet loss in percent
+        void SetFec(bool enabled);
+        void SetPacketLoss(uint32_t percent);
+
+        // voice activity detection, silent frames are not encoded and the
+        // talk spurt is terminated on the first one
+        void SetVadConfig(const AudioVadConfig& config);
+        [[nodiscard]] AudioVadStats GetVadStats() const;
+
     private:
         void reset();
 
+        void accumulate(const int16_t* pcmData, size_t pcmLength, uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink);
+        void encodeFrame(const int16_t* pcm);
+        void emitPacket(uint32_t target, bool is_last, std::span<uint8_t> out, const AudioEncoderSink& sink);
+        void endSpurt(uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink);
+
         void createOpus();
         void destroyOpus();
 
-
     private:
         Logger logger = Logger("mumlib/AudioEncoder");
 
         OpusEncoder* _encoder = nullptr;
+        OpusRepacketizer* _repacketizer = nullptr;
         std::vector<uint8_t> _encoder_buf;
-        
+        std::vector<uint8_t> _repacketizer_buf;
+
         uint32_t _channels = 0;
 
+        //settings, reapplied when the encoder is recreated
+        AudioEncoderProfile _profile;
+        bool _fec = false;
+        uint32_t _packet_loss = 0;
+
+        //input conversion, absent at MUMBLE_AUDIO_SAMPLERATE
+        std::unique_ptr<AudioResampler> _resampler;
+        std::vector<int16_t> _resampler_buf;
+        uint32_t _input_samplerate = MUMBLE_AUDIO_SAMPLERATE;
+        uint32_t _resampler_quality = MUMBLE_RESAMPLER_QUALITY;
+
+        AudioVad _vad;
+
+        //framing
+        uint32_t _frame_ms = 20;
+        uint32_t _frames_per_packet = 1;
+        size_t _frame_samples = 0;
+        size_t _frame_budget = _frame_max_bytes;
+
+        //PCM of the incomplete frame
+        std::vector<int16_t> _pcm_buf;
+        size_t _pcm_fill = 0;
+
+        //encoded frames of the pending packet, _frame_max_bytes apart in _encoder_buf
+        std::vector<opus_int32> _frame_lengths;
+        uint32_t _frames_pending = 0;
+        bool _active = false;
+
         std::chrono::time_point<std::chrono::steady_clock> _sequence_timestemp;
         uint32_t _sequence_number = 0;
 
     private:
         static constexpr std::chrono::seconds _sequence_reset_interval = std::chrono::seconds(5);
+
+        // upper bound of a single Opus frame
+        static constexpr size_t _frame_max_bytes = 1275;
+
+        // Opus payload of a packet that still fits into an encrypted UDP datagram,
+        // the header takes the type byte, a 64-bit sequence varint and the length varint
+        static constexpr size_t _packet_header_max = 1 + 9 + 2;
+        static constexpr size_t _packet_payload_max = MUMBLE_UDP_MAXLENGTH - 4 - _packet_header_max;
     };
 }
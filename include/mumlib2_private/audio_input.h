@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//asio
+#include <asio.hpp>
+
+//mumlib
+#include "mumlib2/logger.h"
+#include "mumlib2/structs.h"
+#include "mumlib2_private/spsc_queue.h"
+
+namespace mumlib2 {
+
+    struct AudioInputChunk {
+        uint32_t target = 0;
+        uint32_t channels = 0;
+
+        // ends the talk spurt, carries no PCM
+        bool flush = false;
+
+        // preallocated for the longest chunk, `samples` per channel are used
+        std::vector<int16_t> pcm;
+        size_t samples = 0;
+    };
+
+    using AudioInputSink = std::function<void(const AudioInputChunk&)>;
+
+    /*
+     * Decouples the capture thread from encoding and sending.
+     *
+     * Push() copies the PCM into a preallocated slot of an SPSC queue and
+     * returns, it neither locks nor allocates nor touches the socket. A timer
+     * on a strand of its own drains the queue every poll_ms and hands the
+     * chunks to the sink, which encodes them.
+     *
+     * Push() and PushFlush() are the producer side of the queue and have to be
+     * called from one thread.
+     *
+     * Handlers keep the input alive through shared_from_this(), it therefore
+     * has to be owned by a std::shared_ptr. After Stop() the sink is not
+     * called anymore.
+     */
+    class AudioInput : public std::enable_shared_from_this<AudioInput> {
+    public:
+        //mark as non-copyable
+        AudioInput(const AudioInput&) = delete;
+        AudioInput& operator=(const AudioInput&) = delete;
+
+        //ctor/dtor
+        AudioInput(asio::io_service& io, const AudioInputConfig& config, uint32_t samplerate, AudioInputSink sink);
+        ~AudioInput() = default;
+
+        void Start();
+        void Stop();
+
+        // capture thread; `samples` per channel, longer PCM is split into several
+        // chunks; returns false if (part of) it was dropped
+        bool Push(const int16_t* pcm, size_t samples, uint32_t channels, uint32_t target);
+
+        // capture thread as well, queued behind the PCM pushed so far
+        bool PushFlush(uint32_t target);
+
+        [[nodiscard]] AudioInputStats GetStats() const;
+
+    private:
+        void schedule();
+        void drain();
+
+    private:
+        Logger _logger = Logger("mumlib/AudioInput");
+
+        AudioInputConfig _config;
+        size_t _chunk_samples = 0;
+
+        asio::strand<asio::io_service::executor_type> _strand;
+        asio::steady_timer _timer;
+
+        SpscQueue<AudioInputChunk> _queue;
+
+        //guards the sink against Stop() while a drain is running
+        std::mutex _sink_mutex;
+        AudioInputSink _sink;
+
+        std::atomic<uint64_t> _stats_pushed = 0;
+        std::atomic<uint64_t> _stats_dropped = 0;
+        std::atomic<uint64_t> _stats_encoded = 0;
+        std::atomic<uint64_t> _stats_failed = 0;
+        std::atomic<uint64_t> _stats_calls = 0;
+        std::atomic<uint64_t> _stats_push_ns = 0;
+        std::atomic<uint64_t> _stats_push_ns_max = 0;
+
+    private:
+        // supported PCM channels
+        static constexpr uint32_t _channels_max = 2;
+    };
+}
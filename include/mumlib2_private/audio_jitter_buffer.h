@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//mumlib
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    /*
+     * Adaptive jitter buffer of a single speaker.
+     *
+     * Packets are stored by their sequence number (one unit = 10 ms of audio) and
+     * handed out in order by Tick(), which has to be called every TickMs. Playback
+     * starts once the buffered audio covers the target delay; the target follows
+     * the configured percentile of the measured arrival jitter. When the buffer
+     * holds noticeably more than the target, frames are skipped to shrink it, an
+     * underrun stops playback until the buffer has refilled.
+     */
+    class AudioJitterBuffer {
+    public:
+        static constexpr uint32_t TickMs = 10;
+        static constexpr size_t Capacity = 64; // in sequence units
+
+        struct Entry {
+            int64_t sequence = 0;
+            uint32_t units = 0;
+            uint8_t target = 0;
+            bool is_last = false;
+            bool valid = false;
+            std::vector<uint8_t> payload;
+        };
+
+        struct Gap {
+            bool missing = false;
+            int64_t sequence = 0;   // first unit of the lost frame
+            uint32_t units = 0;     // assumed duration of the lost frame
+        };
+
+        //mark as non-copyable
+        AudioJitterBuffer(const AudioJitterBuffer&) = delete;
+        AudioJitterBuffer& operator=(const AudioJitterBuffer&) = delete;
+
+        //ctor/dtor
+        explicit AudioJitterBuffer(const JitterBufferConfig& config);
+        ~AudioJitterBuffer() = default;
+
+        void SetConfig(const JitterBufferConfig& config);
+
+        // drops all packets, the delay history and the statistics
+        void Clear();
+
+        // stores a copy of the packet, returns false if it was late or a duplicate
+        bool Push(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, uint32_t units,
+                  std::chrono::steady_clock::time_point now);
+
+        // advances the playout clock by one tick and returns the entry due for
+        // playback, if any; it stays valid until the next Push(). `gap` is set
+        // when a packet was due but is lost.
+        const Entry* Tick(Gap& gap);
+
+        // returns the buffered entry starting at `sequence`, if any
+        [[nodiscard]] const Entry* Peek(int64_t sequence) const;
+
+        [[nodiscard]] bool IsActive() const;
+        [[nodiscard]] uint32_t GetDepth() const;
+        [[nodiscard]] uint32_t GetTarget() const;
+        [[nodiscard]] JitterBufferStats GetStats() const;
+
+    private:
+        Entry& slot(int64_t sequence);
+        void evict(Entry& entry);
+        void reset();
+        void updateTarget(int64_t sequence, uint32_t units, std::chrono::steady_clock::time_point now);
+
+    private:
+        JitterBufferConfig _config;
+
+        std::array<Entry, Capacity> _entries;
+        size_t _count = 0;
+        size_t _count_last = 0;
+
+        //playout clock, in sequence units
+        bool _playing = false;
+        int64_t _play_seq = 0;
+        int64_t _end_seq = 0;
+        uint32_t _remaining = 0;
+        uint32_t _last_units = 2;
+
+        //target delay, in sequence units
+        uint32_t _target = 2;
+
+        //relative arrival delay of the most recent packets, in ms
+        std::array<int64_t, 64> _delays{};
+        size_t _delays_count = 0;
+        size_t _delays_pos = 0;
+        std::chrono::steady_clock::time_point _epoch;
+
+        JitterBufferStats _stats;
+
+    private:
+        // extra buffered units tolerated above the target before frames are skipped
+        static constexpr uint32_t _shrink_hysteresis = 4;
+    };
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+//mumlib
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    struct AudioMixerFrame {
+        int32_t channel_id = -1;
+        uint32_t speakers = 0;
+
+        const int16_t* pcm = nullptr;
+        size_t samples = 0;
+    };
+
+    using AudioMixerSink = std::function<void(const AudioMixerFrame&)>;
+
+    /*
+     * Mixes the decoded PCM of all speakers of a channel into one stream.
+     *
+     * Speakers queue their frames with Push(); Tick() is driven by the jitter
+     * buffer clock (one call per 10 ms) and emits one mixed period per channel
+     * with active speakers. Samples are summed in 32 bit with the per-speaker
+     * gain applied, then brought back to 16 bit by an optional soft limiter and
+     * a saturating pack (SSE2/AVX2/NEON when available).
+     */
+    class AudioMixer {
+    public:
+        static constexpr uint32_t TickMs = 10;
+
+        //mark as non-copyable
+        AudioMixer(const AudioMixer&) = delete;
+        AudioMixer& operator=(const AudioMixer&) = delete;
+
+        //ctor/dtor
+        AudioMixer(uint32_t channels, uint32_t samplerate, const AudioMixerConfig& config);
+        ~AudioMixer() = default;
+
+        void SetConfig(const AudioMixerConfig& config);
+        void SetSamplerate(uint32_t samplerate);
+        [[nodiscard]] bool IsEnabled() const;
+
+        // linear gain of a speaker, 1.0 is unity; kept when the speaker is removed
+        void SetGain(int32_t session_id, float gain);
+
+        // queues decoded PCM (interleaved) of a speaker in the given channel
+        void Push(int32_t channel_id, int32_t session_id, const int16_t* pcm, size_t samples);
+
+        // advances the mixing clock by one tick, returns true while PCM is queued
+        bool Tick(const AudioMixerSink& sink);
+
+        void Remove(int32_t session_id);
+
+    private:
+        struct Speaker {
+            int32_t channel_id = -1;
+            std::vector<int16_t> pcm;
+            size_t offset = 0;
+
+            [[nodiscard]] size_t Available() const { return pcm.size() - offset; }
+        };
+
+        struct Channel {
+            // limiter gain in Q15, carried over between periods
+            int32_t limiter_gain = 1 << 15;
+        };
+
+        void mix(const AudioMixerSink& sink);
+        void limit(Channel& channel, size_t samples);
+
+    private:
+        AudioMixerConfig _config;
+        uint32_t _channels = 0;
+        uint32_t _samplerate = 0;
+        uint32_t _ticks = 0;
+
+        std::map<int32_t, Speaker> _speakers;     //{session_id, Speaker}
+        std::map<int32_t, int32_t> _gains;        //{session_id, gain in Q12}
+        std::map<int32_t, Channel> _mix_channels; //{channel_id, Channel}
+
+        std::vector<int32_t> _accumulator;
+        std::vector<int16_t> _output;
+
+    private:
+        // speakers may buffer at most this much PCM ahead of the mixing clock
+        static constexpr uint32_t _speaker_max_ms = 200;
+
+        // limiter keeps peaks at this level and releases by 1/8 of unity gain per period
+        static constexpr int32_t _limiter_threshold = 29000;
+        static constexpr int32_t _limiter_release_q15 = 1 << 12;
+    };
+}
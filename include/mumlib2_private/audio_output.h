@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <atomic>
+#include <cstdint>
+
+//mumlib
+#include "mumlib2/structs.h"
+#include "mumlib2_private/audio_decoder_session.h"
+#include "mumlib2_private/audio_mixer.h"
+#include "mumlib2_private/spsc_queue.h"
+
+namespace mumlib2 {
+
+    /*
+     * Pull based alternative to Callback::audio() and Callback::audioMixed().
+     *
+     * The transport strand copies every decoded or mixed frame into a bounded
+     * SPSC queue and never waits for the consumer: a full queue drops the frame
+     * and counts an overflow. One application thread drains the queue with Pop()
+     * without taking any lock.
+     */
+    class AudioOutput {
+    public:
+        //mark as non-copyable
+        AudioOutput(const AudioOutput&) = delete;
+        AudioOutput& operator=(const AudioOutput&) = delete;
+
+        //ctor/dtor
+        AudioOutput(const AudioOutputConfig& config, uint32_t channels);
+        ~AudioOutput() = default;
+
+        // producer, the transport strand
+        void Push(const AudioDecoderFrame& frame);
+        void Push(const AudioMixerFrame& frame);
+
+        // consumer, returns false if no frame is queued
+        bool Pop(AudioOutputFrame& frame);
+
+        [[nodiscard]] const AudioOutputConfig& GetConfig() const;
+        [[nodiscard]] AudioOutputStats GetStats() const;
+
+    private:
+        AudioOutputFrame* reserve(const int16_t* pcm, size_t samples);
+
+    private:
+        AudioOutputConfig _config;
+        uint32_t _channels = 0;
+
+        SpscQueue<AudioOutputFrame> _queue;
+
+        std::atomic<uint64_t> _stats_pushed = 0;
+        std::atomic<uint64_t> _stats_popped = 0;
+        std::atomic<uint64_t> _stats_overflows = 0;
+        std::atomic<uint64_t> _stats_underflows = 0;
+    };
+}
@@ -6,6 +6,7 @@
 //stdlib
 #include <array>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 //mumlib
@@ -15,8 +16,6 @@ namespace mumlib2 {
 
 	class AudioPacket {
 	public:
-		static AudioPacket Decode(const uint8_t* buffer, size_t length, size_t pos);
-		
 		static AudioPacket CreateAudioOpusPacket(uint8_t target, int64_t sequence_number, const uint8_t* payload, size_t payload_len, bool is_last);
 		static AudioPacket CreatePingPacket(int64_t timestamp);
 
@@ -25,7 +24,13 @@ namespace mumlib2 {
 		//
 		// Encode
 		//
-		std::vector<uint8_t> Encode();
+		std::vector<uint8_t> Encode() const;
+
+		// write the packet into `out` and return the number of bytes written
+		size_t EncodeInto(std::span<uint8_t> out) const;
+
+		static size_t EncodeOpusInto(std::span<uint8_t> out, uint8_t target, int64_t sequence_number, std::span<const uint8_t> payload, bool is_last);
+		static size_t EncodePingInto(std::span<uint8_t> out, int64_t timestamp);
 
 		//
 		// Getters
@@ -44,10 +49,6 @@ namespace mumlib2 {
 	private:
 		AudioPacket() = default;
 
-		void parse_header(const uint8_t* buffer, size_t length, size_t pos);
-		void parse_audio(const uint8_t* buffer, size_t length, size_t pos);
-		void parse_ping(const uint8_t* buffer, size_t length, size_t pos);
-
 	private:
 		//header fields
 		AudioPacketType _header_type;
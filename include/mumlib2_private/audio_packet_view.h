@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <array>
+#include <cstdint>
+#include <span>
+
+//mumlib
+#include "mumlib2/enums.h"
+
+namespace mumlib2 {
+
+	/*
+	 * Non-owning view of a received voice/ping packet. All fields are parsed in
+	 * place, the payload refers into the buffer passed to Decode() and is only
+	 * valid as long as that buffer is.
+	 */
+	class AudioPacketView {
+	public:
+		static AudioPacketView Decode(std::span<const uint8_t> buffer);
+
+		//
+		// Getters
+		//
+		uint8_t GetHeaderTarget() const;
+		AudioPacketType GetHeaderType() const;
+
+		std::span<const uint8_t> GetAudioPayload() const;
+		int64_t GetAudioSessionId() const;
+		int64_t GetAudioSequenceNumber() const;
+		bool GetAudioLastFlag() const;
+		bool HasAudioPosition() const;
+		std::array<float, 3> GetAudioPosition() const;
+
+		int64_t GetPingTimestamp() const;
+
+	private:
+		AudioPacketView() = default;
+
+		void parse_header(std::span<const uint8_t> buffer, size_t pos);
+		void parse_audio(std::span<const uint8_t> buffer, size_t pos);
+		void parse_ping(std::span<const uint8_t> buffer, size_t pos);
+
+		static int64_t parse_varint(std::span<const uint8_t> buffer, size_t& pos);
+
+	private:
+		//header fields
+		AudioPacketType _header_type = AudioPacketType::Opus;
+		uint8_t _header_target = 0;
+
+		//audio fields
+		int64_t _audio_sessionid = 0;
+		int64_t _audio_sequencenum = 0;
+		bool _audio_last = false;
+		std::span<const uint8_t> _audio_payload;
+		std::span<const uint8_t> _audio_position;
+
+		//ping fields
+		int64_t _ping_timestamp = 0;
+
+	private:
+		static constexpr uint8_t _header_type_mask   = 0b11100000;
+		static constexpr uint8_t _header_target_mask = 0b00011111;
+
+		static constexpr uint16_t _audio_opus_last_mask   = 0x2000;
+		static constexpr uint16_t _audio_opus_length_mask = 0x1FFF;
+
+		static constexpr size_t _audio_position_size = 3 * sizeof(float);
+	};
+}
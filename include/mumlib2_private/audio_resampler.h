@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mumlib2 {
+
+    /*
+     * Streaming polyphase resampler for interleaved 16 bit PCM.
+     *
+     * The rate ratio is reduced to L/M; a Kaiser windowed sinc prototype is
+     * split into L phases of equal length and each output sample is the dot
+     * product of one phase with the most recent input (SSE2/AVX2/NEON when
+     * available). The input tail needed by the next call is kept between
+     * calls, buffers only grow when a larger chunk than before is processed.
+     *
+     * Quality ranges from 0 (fast) to 10 (best) and sets the filter length,
+     * the transition band and the stopband attenuation.
+     */
+    class AudioResampler {
+    public:
+        static constexpr uint32_t QualityMax = 10;
+
+        //mark as non-copyable
+        AudioResampler(const AudioResampler&) = delete;
+        AudioResampler& operator=(const AudioResampler&) = delete;
+
+        //ctor/dtor
+        AudioResampler(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t channels, uint32_t quality);
+        ~AudioResampler() = default;
+
+        // upper bound of the samples (per channel) produced from `in_samples`
+        [[nodiscard]] size_t MaxOutput(size_t in_samples) const;
+
+        // converts `in_samples` (per channel), returns the number of samples
+        // (per channel) written to `out`, which has to hold MaxOutput()
+        size_t Process(const int16_t* in, size_t in_samples, int16_t* out);
+
+        // forgets the input history, e.g. at the end of a talk spurt
+        void Reset();
+
+        [[nodiscard]] uint32_t GetInputSamplerate() const;
+        [[nodiscard]] uint32_t GetOutputSamplerate() const;
+
+    private:
+        void design(uint32_t quality);
+
+    private:
+        uint32_t _input_samplerate = 0;
+        uint32_t _output_samplerate = 0;
+        uint32_t _channels = 0;
+
+        //ratio L/M
+        uint32_t _up = 1;
+        uint32_t _down = 1;
+
+        //filter bank, _up phases of _taps coefficients in Q14
+        size_t _taps = 0;
+        std::vector<int16_t> _coefficients;
+
+        //per channel: _taps - 1 samples of history followed by the new input
+        std::vector<std::vector<int16_t>> _buffers;
+
+        //position of the next output in the (upsampled) input
+        size_t _position = 0;
+        uint32_t _phase = 0;
+    };
+}
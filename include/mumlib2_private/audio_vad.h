@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <cstdint>
+
+//mumlib
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    /*
+     * Voice activity detection on encoder frames.
+     *
+     * A frame is voiced when its energy exceeds both the absolute threshold
+     * and the tracked noise floor by the configured margin. Noise-like frames
+     * (high zero-crossing rate at low energy) need twice the margin. Talking
+     * continues for the hangover time after the last voiced frame so word
+     * endings and short pauses are kept.
+     */
+    class AudioVad {
+    public:
+        //mark as non-copyable
+        AudioVad(const AudioVad&) = delete;
+        AudioVad& operator=(const AudioVad&) = delete;
+
+        //ctor/dtor
+        AudioVad() = default;
+        ~AudioVad() = default;
+
+        void SetConfig(const AudioVadConfig& config);
+        [[nodiscard]] bool IsEnabled() const;
+
+        // classifies an interleaved frame of `duration_ms`, returns true while talking
+        bool Process(const int16_t* pcm, size_t count, uint32_t duration_ms);
+
+        [[nodiscard]] AudioVadStats GetStats() const;
+
+    private:
+        AudioVadConfig _config;
+
+        float _noise_floor_db = -60.0f;
+        uint32_t _hangover_left_ms = 0;
+
+        AudioVadStats _stats;
+
+    private:
+        // noise floor follows drops at once and rises by this much per second
+        static constexpr float _noise_rise_db_per_s = 3.0f;
+
+        // zero crossings per sample above which a frame is treated as noise-like
+        static constexpr float _noise_zcr = 0.35f;
+    };
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//mumlib
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    // fields of a ChannelState message, absent ones are left unchanged
+    struct ChannelTreeUpdate {
+        int32_t channel_id = -1;
+
+        std::optional<int32_t> parent;
+        std::optional<std::string> name;
+        std::optional<std::string> description;
+        std::optional<bool> temporary;
+        std::optional<int32_t> position;
+
+        std::optional<std::vector<uint32_t>> links; //replaces the link set
+        std::vector<uint32_t> links_add;
+        std::vector<uint32_t> links_remove;
+    };
+
+    /*
+     * Channels of the server indexed by id and by name, with the parent/children
+     * adjacency and the (symmetric) link sets.
+     *
+     * The tree is a value type: copying it shares the channel entries, an entry
+     * that is still referenced by a copy is cloned before it is modified.
+     */
+    class ChannelTree {
+    public:
+        //
+        // Lookup
+        //
+
+        [[nodiscard]] const MumbleChannel* Get(int32_t channel_id) const;
+        [[nodiscard]] bool Contains(int32_t channel_id) const;
+        [[nodiscard]] size_t Size() const;
+
+        // first channel with the name, -1 if there is none
+        [[nodiscard]] int32_t Find(const std::string& name) const;
+
+        // walks "Lobby/Team" down from the root channel, the root name may be
+        // given as first component ("Root/Lobby/Team"); -1 if there is none
+        [[nodiscard]] int32_t FindPath(std::string_view path) const;
+
+        [[nodiscard]] std::span<const int32_t> GetChildren(int32_t channel_id) const;
+
+        // all channels ordered by id
+        [[nodiscard]] std::vector<MumbleChannel> GetList() const;
+
+        //
+        // Modification
+        //
+
+        // inserts an unknown channel, merges the present fields into a known one
+        void Update(const ChannelTreeUpdate& update);
+        bool Erase(int32_t channel_id);
+        void Clear();
+
+    private:
+        MumbleChannel& mutate(int32_t channel_id);
+
+        void childAdd(int32_t parent, int32_t channel_id);
+        void childRemove(int32_t parent, int32_t channel_id);
+
+        void nameAdd(const std::string& name, int32_t channel_id);
+        void nameRemove(const std::string& name, int32_t channel_id);
+
+        void linkSet(int32_t channel_id, int32_t other_id, bool state);
+
+    private:
+        std::unordered_map<int32_t, std::shared_ptr<MumbleChannel>> _channels;
+        std::unordered_map<int32_t, std::vector<int32_t>> _children;
+        std::unordered_map<std::string, std::vector<int32_t>> _names;
+
+    private:
+        static constexpr int32_t _root_id = 0;
+    };
+}
@@ -4,11 +4,25 @@
 
 #pragma once
 
+//stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 //openssl
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 
 namespace mumlib2 {
 
+    // one datagram of a CryptState::decryptBatch() call, `ok` is set on return
+    struct CryptBatchItem {
+        const unsigned char* source = nullptr;
+        unsigned char* dst = nullptr;
+        unsigned int crypted_length = 0;
+        bool ok = false;
+    };
+
     class CryptState {
     private:
         unsigned char raw_key[AES_BLOCK_SIZE];
@@ -30,15 +44,67 @@ namespace mumlib2 {
         AES_KEY decrypt_key;
         bool bInit;
 
+        // EVP (AES-NI where available) ECB contexts, nullptr when the portable
+        // AES_encrypt/AES_decrypt path is used. OCB decryption needs the forward
+        // cipher as well; encrypt() and decrypt() may run on different threads,
+        // so each side has a context of its own.
+        EVP_CIPHER_CTX* evp_encrypt = nullptr;
+        EVP_CIPHER_CTX* evp_decrypt_forward = nullptr;
+        EVP_CIPHER_CTX* evp_decrypt = nullptr;
+
+        void initCiphers();
+        void freeCiphers();
+
+        // `ctx` selects the side (evp_encrypt or evp_decrypt_forward)
+        void aesEncryptBlocks(EVP_CIPHER_CTX* ctx, const unsigned char* in, unsigned char* out, size_t blocks);
+        void aesDecryptBlocks(const unsigned char* in, unsigned char* out, size_t blocks);
+
+        // IV/replay bookkeeping of a single datagram, split out of decrypt() so
+        // that decryptBatch() can apply it speculatively and roll it back
+        struct DecryptStep {
+            unsigned char saveiv[AES_BLOCK_SIZE];
+            unsigned char nonce[AES_BLOCK_SIZE];
+            bool restore;
+            int late;
+            int lost;
+            unsigned char history_old;
+        };
+
+        struct OcbJob {
+            const unsigned char* encrypted;
+            unsigned char* plain;
+            unsigned int len;
+            const unsigned char* nonce;
+            unsigned char tag[AES_BLOCK_SIZE];
+        };
+
+        bool decryptBegin(unsigned char ivbyte, DecryptStep& step);
+        void decryptCommit(DecryptStep& step);
+        void decryptUndo(const DecryptStep& step);
+
+        void ocb_decrypt_batch(OcbJob* jobs, size_t count);
+
+        // block/offset scratch space of ocb_decrypt_batch()
+        std::vector<uint64_t> batch_scratch;
+
     public:
         //mark as non-copyable
         CryptState(const CryptState&) = delete;
         CryptState& operator=(const CryptState&) = delete;
 
         CryptState();
+        ~CryptState();
+
+        bool isAccelerated() const;
 
         bool isValid() const;
 
+        // local receive statistics, maintained by decrypt()/decryptBatch()
+        unsigned int getGood() const;
+        unsigned int getLate() const;
+        unsigned int getLost() const;
+        unsigned int getResync() const;
+
         void genKey();
 
         void setKey(const unsigned char *rkey, const unsigned char *eiv, const unsigned char *div);
@@ -57,6 +123,12 @@ namespace mumlib2 {
 
         bool decrypt(const unsigned char *source, unsigned char *dst, unsigned int crypted_length);
 
+        // Decrypts several datagrams at once, pipelining the AES rounds of all
+        // packets. Replay/late/lost accounting is identical to calling decrypt()
+        // on each item in order. Returns the number of items that were accepted.
+        static constexpr size_t DecryptBatchMax = 16;
+        size_t decryptBatch(CryptBatchItem* items, size_t count);
+
         void encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length);
     };
 
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//asio
+#include <asio.hpp>
+
+//mumlib
+#include "mumlib2/logger.h"
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    class Mumlib2Private;
+
+    class Mumlib2HostPrivate {
+    public:
+        //mark as non-copyable
+        Mumlib2HostPrivate(const Mumlib2HostPrivate&) = delete;
+        Mumlib2HostPrivate& operator=(const Mumlib2HostPrivate&) = delete;
+
+        //ctor/dtor
+        explicit Mumlib2HostPrivate(size_t thread_count);
+        ~Mumlib2HostPrivate();
+
+        [[nodiscard]] asio::io_service& IoService();
+
+        //clients
+        void ClientAttach(Mumlib2Private* client);
+        void ClientDetach(Mumlib2Private* client);
+        [[nodiscard]] size_t ClientCount() const;
+
+        //threads
+        [[nodiscard]] size_t ThreadCount() const;
+
+        //stats
+        [[nodiscard]] std::vector<ConnectionStats> StatsGet() const;
+        [[nodiscard]] HostStats StatsGetAggregate() const;
+
+    private:
+        void threadRun();
+
+    private:
+        Logger _logger = Logger("mumlib.Host");
+
+        asio::io_service _io;
+        asio::executor_work_guard<asio::io_service::executor_type> _io_work;
+        std::vector<std::thread> _threads;
+
+        mutable std::mutex _clients_mutex;
+        std::vector<Mumlib2Private*> _clients;
+    };
+}
@@ -4,9 +4,13 @@
 #pragma once
 
 //stdlib
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -16,6 +20,10 @@
 #include "mumlib2/structs.h"
 #include "mumlib2_private/audio_decoder.h"
 #include "mumlib2_private/audio_encoder.h"
+#include "mumlib2_private/audio_input.h"
+#include "mumlib2_private/audio_output.h"
+#include "mumlib2_private/mumlib2_host_private.h"
+#include "mumlib2_private/state_store.h"
 #include "mumlib2_private/transport.h"
 #include "mumble.pb.h"
 
@@ -26,17 +34,41 @@ namespace mumlib2 {
         Mumlib2Private(const Mumlib2Private&) = delete;
         Mumlib2Private& operator=(const Mumlib2Private&) = delete;
 
-        Mumlib2Private(Callback& callback);
+        // connections attached to a host are driven by its thread pool,
+        // otherwise by TransportRun() on a private io_service
+        explicit Mumlib2Private(Callback& callback, Mumlib2HostPrivate* host = nullptr);
+        ~Mumlib2Private();
 
         //Audio
         void AudioSend(const int16_t* pcmData, int pcmLength);
         void AudioSendTarget(const int16_t* pcmData, int pcmLength, uint32_t target);
+        void AudioFlush(uint32_t target);
+        bool AudioSetInputConfig(const AudioInputConfig& config);
+        [[nodiscard]] AudioInputStats AudioGetInputStats() const;
+        void AudioSetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet);
+        void AudioSetSamplerate(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t quality);
+        void AudioSetEncoderProfile(const AudioEncoderProfile& profile);
+        [[nodiscard]] AudioEncoderProfile AudioGetEncoderProfile() const;
+        void AudioSetFec(bool enabled);
+        void AudioSetVadConfig(const AudioVadConfig& config);
+        [[nodiscard]] AudioVadStats AudioGetVadStats() const;
+        void AudioSetDecoderThreads(uint32_t threads);
+        void AudioSetJitterConfig(const JitterBufferConfig& config);
+        [[nodiscard]] std::vector<JitterBufferStats> AudioGetJitterStats() const;
+        void AudioSetMixerConfig(const AudioMixerConfig& config);
+        void AudioSetSpeakerGain(int32_t session_id, float gain);
+        bool AudioSetOutputConfig(const AudioOutputConfig& config);
+        bool AudioOutputPop(AudioOutputFrame& frame);
+        [[nodiscard]] AudioOutputStats AudioGetOutputStats() const;
 
         // ACL
         bool AclSetTokens(const std::vector<std::string>& tokens);
 
         // Channel
         [[nodiscard]] uint32_t ChannelGetCurrent() const;
+        [[nodiscard]] std::string ChannelGetCurrentName() const;
+        [[nodiscard]] std::optional<MumbleChannel> ChannelGet(int32_t channel_id) const;
+        [[nodiscard]] std::vector<MumbleChannel> ChannelGetChildren(int32_t channel_id) const;
         [[nodiscard]] std::vector<MumbleChannel> ChannelGetList() const;
         [[nodiscard]] bool ChannelExists(uint32_t channel_id) const;
         [[nodiscard]] int32_t ChannelFind(const std::string& channel_name) const;
@@ -49,6 +81,7 @@ namespace mumlib2 {
         bool TransportConnect(const std::string& host, uint16_t port, const std::string& user, const std::string& password);
         void TransportDisconnect();
         [[nodiscard]] ConnectionState TransportGetState() const;
+        [[nodiscard]] ConnectionStats TransportGetStats() const;
         void TransportRun();
         void TransportSetCert(const std::string& cert);
         void TransportSetKey(const std::string& key);
@@ -58,9 +91,10 @@ namespace mumlib2 {
         [[nodiscard]] std::vector<MumbleUser> UserGetList() const;
         [[nodiscard]] std::vector<MumbleUser> UserGetInChannel(int32_t channel_id) const;
         [[nodiscard]] bool UserExists(uint32_t user_id) const;
-        [[nodiscard]] bool UserMuted(int32_t user_id);
+        [[nodiscard]] bool UserMuted(int32_t user_id) const;
         [[nodiscard]] int32_t UserFind(const std::string& user_name) const;
         bool UserMute(int32_t user_id, bool mute_state);
+        bool UserRequestBlob(int32_t user_id, UserField fields);
         bool UserSendState(UserState field, const std::string& val);
         bool UserSendState(UserState field, bool val);
 
@@ -75,9 +109,18 @@ namespace mumlib2 {
         // Audio
         void audioDecoderCreate(uint32_t output_samplerate);
         void audioEncoderCreate(uint32_t input_samplerate, uint32_t output_bitrate);
+        void audioEncode(const int16_t* pcmData, size_t pcmLength, uint32_t channels, uint32_t target);
+        void audioFlush(uint32_t target);
+        void audioInput(const AudioInputChunk& chunk);
+        void audioEncoderUpdateBitrate();
+        void audioEncoderUpdateLoss();
+        void audioSendPacket(std::span<const uint8_t> packet);
+        void audioFrame(const AudioDecoderFrame& frame);
+        void audioMixed(const AudioMixerFrame& frame);
+        void audioMaintenance();
+        bool audioTick();
 
         // Channel
-        void channelEmplace(MumbleChannel& channel);
         void channelErase(uint32_t channel_id);
         void channelSet(uint32_t channel_id);
 
@@ -94,18 +137,18 @@ namespace mumlib2 {
         bool processControlUserStatePacket(const uint8_t* buffer, int length);
         bool processControlServerconfigPacket(const uint8_t* buffer, int length);
         bool processControlServersyncPacket(const uint8_t* buffer, int length);
-        bool processAudioPacket(AudioPacket& packet);
+        bool processAudioPacket(const AudioPacketView& packet);
 
         // User
-        void userClear();
         void userErase(uint32_t user_id);
-        void userUpdate(MumbleUser& user);   
+        UserTableChange userUpdate(const UserTableUpdate& update);
 
         //Session
         [[nodiscard]] uint32_t sessionGet() const;
 
         //Transport
         void transportCreate();
+        [[nodiscard]] std::shared_ptr<Transport> transportGet() const;
         bool transportSendAuthentication(const std::vector<std::string>& tokens);
         bool transportSendControl(MessageType type, google::protobuf::Message& message);
         bool transportSendAudio(const uint8_t* data, size_t len);
@@ -114,31 +157,46 @@ namespace mumlib2 {
         //Audio
         std::unique_ptr<AudioDecoder> _audio_decoder;
         std::unique_ptr<AudioEncoder> _audio_encoder;
-        uint32_t _audio_bitrate = MUMBLE_OPUS_BITRATE;
+        std::shared_ptr<AudioInput> _audio_input;
+        std::unique_ptr<AudioOutput> _audio_output;
+        AudioEncoderProfile _audio_profile;
+        uint32_t _audio_bitrate_maxbandwidth = 0;
+
+        //the encoder runs on the input strand (or the sending thread without
+        //one), the settings are changed from any thread
+        mutable std::mutex _audio_encoder_mutex;
+        std::atomic<uint32_t> _audio_channels = MUMBLE_AUDIO_CHANNELS;
+
+        //FEC, expected loss is taken from the voice channel counters
+        bool _audio_fec = false;
+        std::chrono::steady_clock::time_point _audio_loss_timestamp;
+        uint32_t _audio_loss_received = 0;
+        uint32_t _audio_loss_missed = 0;
 
         //Callback
         Callback& _callback;
 
-        //Channel
-        std::vector<MumbleChannel> _channel_list;
-        uint32_t _channel_current = 0;
-
         //Logger
         Logger _logger = Logger("");
 
+        //Host
+        Mumlib2HostPrivate* _host = nullptr;
+
         //Transport
-        std::unique_ptr<Transport> _transport;
+        std::unique_ptr<asio::io_service> _transport_io; //standalone only, must outlive _transport
+        std::shared_ptr<Transport> _transport;
+        mutable std::mutex _transport_mutex;
         std::string _transport_cert;
         std::string _transport_key;
 
-        //User
-        std::map<int32_t, MumbleUser> _user_map; //{session_id, MumbleUser}
+        //State, users and channels; written on the transport strand, read from any thread
+        StateStore _state;
 
         //Session
         uint32_t _session_id = 0;
 
         //Server
-        uint32_t _server_maxbandwidth = 0;
+        std::atomic<uint32_t> _server_maxbandwidth = 0;
         uint32_t _server_allowhtml = 0;
         uint32_t _server_imagemessagelength = 0;
         uint32_t _server_messagelength = 0;
@@ -151,5 +209,13 @@ namespace mumlib2 {
         //audio
         static constexpr uint32_t _audio_rx_buffer_length = 60;
         static constexpr uint32_t _audio_tx_buffer_size = 8192;
+        static constexpr std::chrono::seconds _audio_loss_interval = std::chrono::seconds(2);
+
+        // bytes per voice packet on top of the Opus payload:
+        // IPv4 (20) + UDP (8) + OCB (4) + header (1) + sequence (2) + length (2)
+        static constexpr uint32_t _audio_packet_overhead = 37;
+        static constexpr uint32_t _audio_bitrate_min = 6000;
+
+        std::array<uint8_t, _audio_tx_buffer_size> _audio_tx_buffer{};
     };
 }
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace mumlib2 {
+
+    /*
+     * Bounded lock-free queue for exactly one producer and one consumer thread.
+     *
+     * Slots are allocated once and reused: the producer fills the slot returned
+     * by Back() and publishes it with Push(), the consumer reads Front() and
+     * releases it with Pop(). Members of T (e.g. a std::vector) keep their
+     * capacity between uses, so a steady stream does not allocate.
+     */
+    template<typename T>
+    class SpscQueue {
+    public:
+        //mark as non-copyable
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        //ctor/dtor, every slot starts as a copy of `prototype`
+        explicit SpscQueue(size_t capacity, const T& prototype = T())
+            : _slots(std::bit_ceil(capacity < 2 ? size_t(2) : capacity), prototype), _mask(_slots.size() - 1) {}
+        ~SpscQueue() = default;
+
+        //
+        // Producer
+        //
+
+        // free slot to fill, nullptr if the queue is full
+        T* Back()
+        {
+            auto tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head_cached == _slots.size()) {
+                _head_cached = _head.load(std::memory_order_acquire);
+                if (tail - _head_cached == _slots.size()) {
+                    return nullptr;
+                }
+            }
+            return &_slots[tail & _mask];
+        }
+
+        // publishes the slot returned by Back()
+        void Push()
+        {
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        //
+        // Consumer
+        //
+
+        // oldest published slot, nullptr if the queue is empty
+        T* Front()
+        {
+            auto head = _head.load(std::memory_order_relaxed);
+            if (head == _tail_cached) {
+                _tail_cached = _tail.load(std::memory_order_acquire);
+                if (head == _tail_cached) {
+                    return nullptr;
+                }
+            }
+            return &_slots[head & _mask];
+        }
+
+        // hands the slot returned by Front() back to the producer
+        void Pop()
+        {
+            _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        //
+        // Getters
+        //
+
+        // approximate when called concurrently
+        [[nodiscard]] size_t Size() const
+        {
+            return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] size_t Capacity() const
+        {
+            return _slots.size();
+        }
+
+    private:
+        std::vector<T> _slots;
+        size_t _mask = 0;
+
+        //consumer side
+        alignas(64) std::atomic<size_t> _head = 0;
+        size_t _tail_cached = 0;
+
+        //producer side
+        alignas(64) std::atomic<size_t> _tail = 0;
+        size_t _head_cached = 0;
+    };
+}
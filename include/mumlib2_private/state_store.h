@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//mumlib
+#include "mumlib2/structs.h"
+#include "mumlib2_private/channel_tree.h"
+#include "mumlib2_private/user_table.h"
+
+namespace mumlib2 {
+
+    // immutable once published; the tables are shared between snapshots
+    // until the side they belong to changes
+    struct StateSnapshot {
+        std::shared_ptr<const UserTable> users;
+        std::shared_ptr<const ChannelTree> channels;
+        uint32_t channel_current = 0;
+    };
+
+    /*
+     * Copy-on-write store of the server state (users and channels).
+     *
+     * Writers (the transport strand, local mutes from the application) are
+     * serialized and modify a working state. Readers take the current snapshot
+     * (a reference count increment under a short pointer lock) and keep a
+     * consistent view for as long as they hold it. After a change the first
+     * reader publishes a copy of the changed table only, so a burst of updates
+     * such as the initial sync of thousands of channels costs one copy rather
+     * than one per message, and updates nobody reads cost none.
+     *
+     * Lookups on the writer's strand (the mixer, the voice packet mute check)
+     * read the working state and never publish.
+     *
+     * The local mute state is mirrored in an atomic bitmap, so the check on
+     * every voice packet neither locks nor touches the snapshot.
+     */
+    class StateStore {
+    public:
+        using Snapshot = std::shared_ptr<const StateSnapshot>;
+
+        //mark as non-copyable
+        StateStore(const StateStore&) = delete;
+        StateStore& operator=(const StateStore&) = delete;
+
+        //ctor/dtor
+        StateStore();
+        ~StateStore() = default;
+
+        //
+        // Readers, any thread
+        //
+
+        [[nodiscard]] Snapshot Get() const;
+
+        // working state, see above
+        [[nodiscard]] bool IsMuted(int32_t session_id) const;
+        [[nodiscard]] int32_t UserChannel(int32_t session_id) const; //-1 if unknown
+
+        //
+        // Writers
+        //
+
+        void Clear();
+
+        void ChannelUpdate(const ChannelTreeUpdate& update);
+        void ChannelErase(int32_t channel_id);
+        void ChannelSet(uint32_t channel_id);
+
+        // see UserTable::Update(), an update without changes is not published
+        UserTableChange UserUpdate(const UserTableUpdate& update);
+        void UserErase(int32_t session_id);
+
+        // returns false if the user is unknown
+        bool UserMute(int32_t session_id, bool mute_state);
+
+    private:
+        void publish() const;
+        void changed(bool users, bool channels);
+        void muteSet(int32_t session_id, bool mute_state);
+
+    private:
+        //published state
+        mutable Snapshot _snapshot;
+        mutable std::mutex _snapshot_mutex; //guards the pointer only
+
+        //working state
+        UserTable _users;
+        ChannelTree _channels;
+        uint32_t _channel_current = 0;
+        mutable bool _users_changed = false;
+        mutable bool _channels_changed = false;
+        mutable std::atomic<bool> _working_dirty = false;
+        mutable std::mutex _writer_mutex;
+
+        //local mute of the session ids below _mute_indexed_max
+        std::array<std::atomic<uint64_t>, 64> _mute_bits{};
+
+    private:
+        static constexpr int32_t _mute_indexed_max = 64 * 64;
+    };
+}
@@ -5,9 +5,13 @@
 
 //stdlib
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -24,19 +28,34 @@
 #include "mumlib2/constants.h"
 #include "mumlib2/enums.h"
 #include "mumlib2/logger.h"
+#include "mumlib2/structs.h"
 #include "mumlib2_private/audio_packet.h"
+#include "mumlib2_private/audio_packet_view.h"
 #include "mumlib2_private/crypto_state.h"
 #include "mumlib2_private/transport_ssl_context.h"
+#include "mumlib2_private/transport_udp_batch.h"
+#include "mumlib2_private/transport_udp_pool.h"
+#include "mumlib2_private/transport_write_queue.h"
 #include "mumlib2_private/varint.h"
 
 
 namespace mumlib2 {
 
-    class Transport {
+    /*
+     * All socket operations and completion handlers run on a strand of the given
+     * io_service, so several transports may share one io_service driven by a
+     * thread pool (see Mumlib2Host). Handlers keep the transport alive through
+     * shared_from_this(), it therefore has to be owned by a std::shared_ptr.
+     */
+    class Transport : public std::enable_shared_from_this<Transport> {
     public:
         Transport(
+                  asio::io_service& ioService,
+                  bool sharedIo,
                   std::function<bool(MessageType, uint8_t*, int)> processControlMessageFunc,
-                  std::function<bool(AudioPacket&)>                processEncodedAudioPacketFunction,
+                  std::function<bool(const AudioPacketView&)>      processEncodedAudioPacketFunction,
+                  std::function<bool()>                             processTickFunction,
+                  std::function<void()>                             processMaintenanceFunction,
                   std::string cert_file = "",
                   std::string privkey_file = "");
 
@@ -47,6 +66,11 @@ namespace mumlib2 {
 
         void connect(const std::string& host, int port, const std::string& user, const std::string& password);
 
+        // No callback runs after this returns, apart from the one calling it. A
+        // callback running on another thread is waited for, unless the caller
+        // is itself inside a transport callback (e.g. on a Mumlib2Host pool
+        // thread), where waiting could deadlock. On a shared io_service the
+        // sockets are closed asynchronously on the strand.
         void disconnect();
 
         ConnectionState getConnectionState() {
@@ -55,20 +79,42 @@ namespace mumlib2 {
 
         bool isUdpActive();
 
-        void sendControlMessage(MessageType type, google::protobuf::Message &message);
+        // return false if the message was refused because the outbound queue is full
+        bool sendControlMessage(MessageType type, google::protobuf::Message &message);
 
-        void sendEncodedAudioPacket(const uint8_t *buffer, int length);
+        bool sendEncodedAudioPacket(const uint8_t *buffer, int length);
 
-        void run(){
-            ioService.run();
-        }
+        // thread safe variant, the packet is copied into a slot of the UDP pool
+        // and sent from the strand; returns false if it was dropped
+        bool postEncodedAudioPacket(std::span<const uint8_t> packet);
+
+        // runs processTickFunction every TICK_INTERVAL on the strand until it
+        // returns false; must be called from the strand
+        void requestTick();
 
         void sendAuthentication(std::optional<const std::vector<std::string>> tokens);
 
+        UdpPoolStats getUdpPoolStats() const;
+
+        // all zero unless built with MUMLIB2_UDP_MMSG
+        UdpBatchStats getUdpBatchStats() const;
+
+        void setUdpPoolFallback(UdpPoolFallback fallback);
+
+        WriteQueueStats getSslWriteQueueStats() const;
+
+        void setSslWriteHighwater(size_t highwater);
+
+        ConnectionStats getStats() const;
+
     private:
         Logger logger;
 
-        asio::io_service ioService;
+        asio::io_service& ioService;
+        asio::strand<asio::io_service::executor_type> strand;
+
+        // the io_service is shared with other transports, it must not be stopped on disconnect
+        bool sharedIo;
 
         std::pair<std::string, int> connectionParams;
 
@@ -76,40 +122,75 @@ namespace mumlib2 {
 
         std::function<bool(MessageType, uint8_t*, int)> processMessageFunction;
 
-        std::function<bool(AudioPacket&)> processEncodedAudioPacketFunction;
+        // returns true if buffered audio is waiting for processTickFunction
+        std::function<bool(const AudioPacketView&)> processEncodedAudioPacketFunction;
+
+        std::function<bool()> processTickFunction;
 
-        volatile bool udpActive;
+        // housekeeping, runs with every ping while connected
+        std::function<void()> processMaintenanceFunction;
 
-        ConnectionState state = ConnectionState::NOT_CONNECTED;
+        std::atomic<bool> udpActive = false;
+
+        std::atomic<ConnectionState> state = ConnectionState::NOT_CONNECTED;
         PingState ping_state = PingState::NONE;
 
         asio::ip::udp::socket udpSocket;
         asio::ip::udp::endpoint udpReceiverEndpoint;
         uint8_t udpIncomingBuffer[MUMBLE_UDP_MAXLENGTH];
+        TransportUdpPool udpPool;
+#if defined(MUMLIB2_UDP_MMSG)
+        TransportUdpBatch udpBatch;
+        std::array<std::array<uint8_t, MUMBLE_UDP_MAXLENGTH>, TransportUdpBatch::RecvBatchSize> udpPlainBuffers;
+#endif
         CryptState cryptState;
 
+        // receive counters of cryptState, copied on the strand after every
+        // decrypt so getStats() can read them from any thread
+        std::atomic<uint32_t> cryptGood = 0;
+        std::atomic<uint32_t> cryptLate = 0;
+        std::atomic<uint32_t> cryptLost = 0;
+        std::atomic<uint32_t> cryptResync = 0;
+        void cryptStatsUpdate();
+
         asio::ssl::context sslContext;
         SslContextHelper sslContextHelper;
         asio::ssl::stream<asio::ip::tcp::socket> sslSocket;
         std::array<uint8_t, MUMBLE_TCP_MAXLENGTH> sslIncomingBuffer;
+        TransportWriteQueue sslWriteQueue;
+        std::vector<asio::const_buffer> sslWriteBuffers;
 
 
         asio::steady_timer pingTimer;
+
+        asio::steady_timer tickTimer;
+        bool tickActive = false;
         std::chrono::time_point<std::chrono::system_clock> lastReceivedUdpPacketTimestamp;
 
+        void disconnectInternal();
+
+        // runs a process*Function unless disconnect() detached them
+        template<typename F, typename R>
+        R invokeCallback(F&& fn, R detached);
+
+        std::mutex callbackMutex;
+        std::atomic<bool> callbackEnabled = true;
+
         void pingTimerTick(const std::error_code &e);
 
+        void tickTimerTick(const std::error_code &e);
+
         void sslConnectHandler(const std::error_code &error);
 
         void sslHandshakeHandler(const std::error_code &error);
 
         void doReceiveSsl();
 
-        void sendSsl(uint8_t *buff, int length);
+        void scheduleWriteSsl();
 
-        void sendSslAsync(uint8_t *buff, int length);
+        void doWriteSsl();
 
-        void sendControlMessagePrivate(MessageType type, google::protobuf::Message &message);
+        bool sendControlMessagePrivate(MessageType type, google::protobuf::Message &message);
 
         void sendSslPing();
 
@@ -117,8 +198,16 @@ namespace mumlib2 {
 
         void processMessageInternal(MessageType messageType, uint8_t *buffer, int length);
 
+        void processAudioPacketInternal(std::span<const uint8_t> buffer);
+
         void doReceiveUdp();
 
+#if defined(MUMLIB2_UDP_MMSG)
+        void receiveUdpBatch();
+
+        void flushUdp();
+#endif
+
         void sendUdpAsync(const uint8_t *buff, int length);
 
         void sendUdpPing();
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+//mumlib
+#include "mumlib2/constants.h"
+#include "mumlib2_private/crypto_state.h"
+#include "mumlib2_private/transport_udp_pool.h"
+
+#if defined(MUMLIB2_UDP_MMSG)
+//linux
+#include <sys/socket.h>
+#endif
+
+namespace mumlib2 {
+
+    struct UdpBatchStats {
+        uint64_t recv_syscalls = 0;
+        uint64_t recv_datagrams = 0;
+        uint64_t send_syscalls = 0;
+        uint64_t send_datagrams = 0;
+    };
+
+#if defined(MUMLIB2_UDP_MMSG)
+
+    /*
+     * Batched UDP I/O for Linux. Incoming datagrams are drained with recvmmsg()
+     * once the socket reports readiness, outgoing datagrams are collected from
+     * any thread and flushed with a single sendmmsg() on the I/O thread.
+     *
+     * The socket must be in non-blocking mode.
+     */
+    class TransportUdpBatch {
+    public:
+        // matches the CryptState batch size so a drained batch is decrypted at once
+        static constexpr size_t RecvBatchSize = CryptState::DecryptBatchMax;
+        static constexpr size_t SendBatchSize = 64;
+
+        //mark as non-copyable
+        TransportUdpBatch(const TransportUdpBatch&) = delete;
+        TransportUdpBatch& operator=(const TransportUdpBatch&) = delete;
+
+        //ctor/dtor
+        TransportUdpBatch() = default;
+        ~TransportUdpBatch() = default;
+
+        //
+        // Receive (I/O thread)
+        //
+
+        // receives up to RecvBatchSize datagrams, returns 0 when the socket has
+        // nothing left to read or on error (reported through `ec`)
+        size_t Receive(int fd, std::error_code& ec);
+
+        [[nodiscard]] std::span<const uint8_t> Datagram(size_t index) const;
+
+        //
+        // Send
+        //
+
+        // queues an encrypted datagram taken from the pool, returns true if the
+        // caller has to schedule a Flush() on the I/O thread
+        bool Queue(uint8_t* buffer, size_t length);
+
+        // sends the queued datagrams and returns their buffers to the pool;
+        // returns false if the socket would block and datagrams are still queued
+        // (or on error, reported through `ec`)
+        bool Flush(int fd, const sockaddr* addr, socklen_t addrlen, TransportUdpPool& pool, std::error_code& ec);
+
+        // drops all queued datagrams
+        void Clear(TransportUdpPool& pool);
+
+        [[nodiscard]] UdpBatchStats GetStats() const;
+
+    private:
+        //receive
+        std::array<std::array<uint8_t, MUMBLE_UDP_MAXLENGTH>, RecvBatchSize> _rx_buffers{};
+        std::array<size_t, RecvBatchSize> _rx_lengths{};
+
+        //send
+        std::mutex _tx_mutex;
+        std::vector<std::pair<uint8_t*, size_t>> _tx_queue;
+        bool _tx_scheduled = false;
+
+        std::atomic<uint64_t> _stat_recv_syscalls = 0;
+        std::atomic<uint64_t> _stat_recv_datagrams = 0;
+        std::atomic<uint64_t> _stat_send_syscalls = 0;
+        std::atomic<uint64_t> _stat_send_datagrams = 0;
+    };
+
+#endif
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//mumlib
+#include "mumlib2/constants.h"
+
+namespace mumlib2 {
+
+    enum class UdpPoolFallback {
+        ALLOCATE, // hand out a heap buffer when all slots are busy
+        DROP      // drop the datagram when all slots are busy
+    };
+
+    struct UdpPoolStats {
+        uint64_t acquired = 0;
+        uint64_t exhausted = 0;
+        uint64_t fallback_allocated = 0;
+        uint64_t dropped = 0;
+        uint32_t in_use = 0;
+        uint32_t in_use_peak = 0;
+    };
+
+    /*
+     * Fixed set of MTU-sized datagram slots that are handed out for outgoing UDP
+     * packets and returned from the send completion handler. Acquire/Release are
+     * lock-free and may be called from any thread.
+     */
+    class TransportUdpPool {
+    public:
+        static constexpr size_t SlotCount = 64;
+        static constexpr size_t SlotSize = MUMBLE_UDP_MAXLENGTH;
+
+        //mark as non-copyable
+        TransportUdpPool(const TransportUdpPool&) = delete;
+        TransportUdpPool& operator=(const TransportUdpPool&) = delete;
+
+        //ctor/dtor
+        explicit TransportUdpPool(UdpPoolFallback fallback = UdpPoolFallback::ALLOCATE);
+        ~TransportUdpPool() = default;
+
+        // returns nullptr when the pool is exhausted and the fallback policy is DROP
+        [[nodiscard]] uint8_t* Acquire();
+        void Release(uint8_t* buffer);
+
+        void SetFallback(UdpPoolFallback fallback);
+        [[nodiscard]] UdpPoolStats GetStats() const;
+
+    private:
+        [[nodiscard]] bool owns(const uint8_t* buffer) const;
+
+    private:
+        alignas(64) std::array<std::array<uint8_t, SlotSize>, SlotCount> _slots{};
+
+        static_assert(SlotCount <= 64, "free mask is a single 64-bit word");
+        std::atomic<uint64_t> _free_mask;
+        std::atomic<UdpPoolFallback> _fallback;
+
+        std::atomic<uint64_t> _stat_acquired = 0;
+        std::atomic<uint64_t> _stat_exhausted = 0;
+        std::atomic<uint64_t> _stat_fallback_allocated = 0;
+        std::atomic<uint64_t> _stat_dropped = 0;
+        std::atomic<uint32_t> _stat_in_use = 0;
+        std::atomic<uint32_t> _stat_in_use_peak = 0;
+    };
+}
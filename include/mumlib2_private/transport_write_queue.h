@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//asio
+#include <asio.hpp>
+
+namespace mumlib2 {
+
+    struct WriteQueueStats {
+        uint64_t messages = 0;
+        uint64_t coalesced = 0;
+        uint64_t writes = 0;
+        uint64_t rejected = 0;
+        size_t queued_bytes = 0;
+        size_t queued_bytes_peak = 0;
+    };
+
+    /*
+     * Outbound queue for the TLS control channel. Framed messages are appended
+     * into a chain of reusable chunks; consecutive messages share a chunk so that
+     * one scatter/gather write flushes everything queued since the last write.
+     *
+     * Push() may be called from any thread, BeginWrite()/EndWrite() only from the
+     * thread that drives the SSL stream.
+     */
+    class TransportWriteQueue {
+    public:
+        static constexpr size_t ChunkSize = 16 * 1024;
+        static constexpr size_t DefaultHighwater = 1024 * 1024;
+
+        //mark as non-copyable
+        TransportWriteQueue(const TransportWriteQueue&) = delete;
+        TransportWriteQueue& operator=(const TransportWriteQueue&) = delete;
+
+        //ctor/dtor
+        explicit TransportWriteQueue(size_t highwater = DefaultHighwater);
+        ~TransportWriteQueue() = default;
+
+        // returns false when the message would push the queue above the high-water mark;
+        // droppable messages (tunnelled voice) are already refused at half of it
+        bool Push(const uint8_t* data, size_t length, bool droppable = false);
+
+        // reserves exactly `length` bytes at the tail of the chain and lets `writer`
+        // fill them in place, so framing and serialization need no intermediate buffer
+        template<typename Writer>
+        bool Emplace(size_t length, bool droppable, Writer&& writer)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            uint8_t* out = reserve(length, droppable);
+            if (!out) {
+                return false;
+            }
+
+            writer(out);
+            return true;
+        }
+
+        // moves everything pending into the in-flight set, returns false if there is
+        // nothing to write or a write is already in progress
+        bool BeginWrite(std::vector<asio::const_buffer>& buffers);
+        void EndWrite();
+
+        void Clear();
+
+        void SetHighwater(size_t highwater);
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] WriteQueueStats GetStats() const;
+
+    private:
+        // uninitialized, reusable storage so that reserving does not zero-fill
+        struct Chunk {
+            std::unique_ptr<uint8_t[]> data;
+            size_t size = 0;
+            size_t capacity = 0;
+        };
+
+        uint8_t* reserve(size_t length, bool droppable);
+        Chunk& chunkFor(size_t length);
+
+    private:
+        mutable std::mutex _mutex;
+
+        std::vector<Chunk> _pending;
+        std::vector<Chunk> _inflight;
+        std::vector<Chunk> _free;
+
+        bool _writing = false;
+        size_t _highwater = DefaultHighwater;
+        size_t _queued = 0;
+
+        WriteQueueStats _stats;
+
+    private:
+        static constexpr size_t _free_chunks_max = 8;
+    };
+}
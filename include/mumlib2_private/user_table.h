@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+#pragma once
+
+//stdlib
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//mumlib
+#include "mumlib2/structs.h"
+
+namespace mumlib2 {
+
+    // fields of a UserState message, absent ones are left unchanged
+    struct UserTableUpdate {
+        int32_t session_id = -1;
+
+        std::optional<std::string> name;
+        std::optional<int32_t> channel_id;
+        std::optional<int32_t> user_id;
+        std::optional<bool> mute;
+        std::optional<bool> deaf;
+        std::optional<bool> suppress;
+        std::optional<bool> self_mute;
+        std::optional<bool> self_deaf;
+        std::optional<bool> priority_speaker;
+        std::optional<bool> recording;
+        std::optional<std::string> hash;
+        std::optional<std::string> comment_hash;
+        std::optional<std::string> texture_hash;
+    };
+
+    struct UserTableChange {
+        UserField fields = UserField::NONE; //NONE if the update changed nothing
+        int32_t channel_from = -1; //-1 for a new user
+        std::shared_ptr<const MumbleUser> user;
+    };
+
+    /*
+     * Users of the server indexed by session id, by name and by channel.
+     *
+     * The table is a value type: copying it shares the user entries, an entry
+     * that is still referenced by a copy is cloned before it is modified.
+     */
+    class UserTable {
+    public:
+        //
+        // Lookup
+        //
+
+        [[nodiscard]] const MumbleUser* Get(int32_t session_id) const;
+        [[nodiscard]] bool Contains(int32_t session_id) const;
+        [[nodiscard]] size_t Size() const;
+
+        // session id of the user with the name, -1 if there is none
+        [[nodiscard]] int32_t Find(const std::string& name) const;
+
+        // session ids of the users in the channel
+        [[nodiscard]] std::span<const int32_t> GetInChannel(int32_t channel_id) const;
+
+        // all users ordered by session id
+        [[nodiscard]] std::vector<MumbleUser> GetList() const;
+
+        //
+        // Modification
+        //
+
+        // inserts an unknown user (in the root channel unless given) or merges
+        // the present fields into a known one, reports the fields that changed
+        UserTableChange Update(const UserTableUpdate& update);
+        bool Erase(int32_t session_id);
+        void Clear();
+
+        // returns false if the user is unknown
+        bool SetLocalMute(int32_t session_id, bool mute_state);
+
+    private:
+        MumbleUser& mutate(int32_t session_id);
+
+        void channelAdd(int32_t channel_id, int32_t session_id);
+        void channelRemove(int32_t channel_id, int32_t session_id);
+
+        void nameSet(const std::string& name, int32_t session_id);
+        void nameRemove(const std::string& name, int32_t session_id);
+
+    private:
+        std::unordered_map<int32_t, std::shared_ptr<MumbleUser>> _users;
+        std::unordered_map<std::string, int32_t> _names;
+        std::unordered_map<int32_t, std::vector<int32_t>> _channels;
+    };
+}
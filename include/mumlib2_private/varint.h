@@ -4,15 +4,34 @@
 #pragma once
 
 //stdlib
+#include <array>
+#include <bit>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 namespace mumlib2 {
 
+    /*
+     * Mumble variable length integer.
+     *
+     *   0xxxxxxx                   7 bit positive
+     *   10xxxxxx + 1 byte          14 bit positive
+     *   110xxxxx + 2 bytes         21 bit positive
+     *   1110xxxx + 3 bytes         28 bit positive
+     *   111100__ + 4 bytes         32 bit positive
+     *   111101__ + 8 bytes         64 bit number
+     *   111110__ + varint          negative recursive (~varint)
+     *   111111xx                   byte-inverted negative two bit number (~xx)
+     */
     class VarInt {
     public:
+        // unchecked, the caller guarantees that the buffer holds a complete varint
         explicit VarInt(const uint8_t* buf);
 
+        // bounds-checked, throws VarIntException on a truncated or malformed varint
+        explicit VarInt(std::span<const uint8_t> buf);
+
         explicit VarInt(int8_t val);
         explicit VarInt(int16_t val);
         explicit VarInt(int32_t val);
@@ -20,15 +39,89 @@ namespace mumlib2 {
         explicit VarInt(int64_t val);
 
         [[nodiscard]] size_t Size() const;
-        [[nodiscard]] size_t Value() const;
+        [[nodiscard]] int64_t Value() const;
 
         [[nodiscard]] std::vector<uint8_t> Encode() const;
-        
+
+        // writes the encoded value into `out` and returns the number of bytes written
+        size_t EncodeInto(std::span<uint8_t> out) const;
+
+        //
+        // Static codec
+        //
+
+        static constexpr size_t MaxSize = 9;
+
+        [[nodiscard]] static constexpr size_t EncodedSize(int64_t val);
+
+        // `out` must have room for EncodedSize(val) bytes
+        static size_t EncodeUnchecked(int64_t val, uint8_t* out);
+
+        // return the number of bytes consumed; the checked variant returns 0 if
+        // the buffer is truncated or the encoding is malformed
+        static size_t DecodeUnchecked(const uint8_t* buf, int64_t& val);
+        static size_t Decode(std::span<const uint8_t> buf, int64_t& val);
+
     private:
-        void parse(const uint8_t* buf);
+        enum class Kind : uint8_t {
+            Positive,
+            NegativeRecursive,
+            NegativeTwoBit
+        };
+
+        struct Format {
+            Kind kind;
+            uint8_t width; // total bytes including the prefix, 1 for the negative forms
+            uint8_t mask;  // value bits carried in the prefix byte
+        };
+
+        // indexed by the prefix byte, derived from its leading-ones count
+        static constexpr std::array<Format, 256> _formats = [] {
+            std::array<Format, 256> table{};
+            for (size_t prefix = 0; prefix < table.size(); prefix++) {
+                auto ones = std::countl_one(static_cast<uint8_t>(prefix));
+                switch (ones) {
+                case 0:
+                case 1:
+                case 2:
+                case 3:
+                    table[prefix] = { Kind::Positive, static_cast<uint8_t>(ones + 1), static_cast<uint8_t>(0x7F >> ones) };
+                    break;
+                case 4:
+                    table[prefix] = { Kind::Positive, static_cast<uint8_t>((prefix & 0x04) ? 9 : 5), 0x00 };
+                    break;
+                case 5:
+                    table[prefix] = { Kind::NegativeRecursive, 1, 0x00 };
+                    break;
+                default:
+                    table[prefix] = { Kind::NegativeTwoBit, 1, 0x03 };
+                    break;
+                }
+            }
+            return table;
+        }();
+
+        // encoded size of a non-negative value, indexed by its bit width
+        static constexpr std::array<uint8_t, 65> _sizes = [] {
+            std::array<uint8_t, 65> table{};
+            for (size_t bits = 0; bits < table.size(); bits++) {
+                table[bits] = bits <= 7 ? 1 : bits <= 14 ? 2 : bits <= 21 ? 3 : bits <= 28 ? 4 : bits <= 32 ? 5 : 9;
+            }
+            return table;
+        }();
 
     private:
         int64_t _val = 0;
         size_t _size = 0;
     };
+
+    constexpr size_t VarInt::EncodedSize(int64_t val)
+    {
+        auto u = static_cast<uint64_t>(val);
+        if (val < 0 && ~u < 0x100000000ULL) {
+            u = ~u;
+            return u <= 0x3 ? 1 : 1 + _sizes[std::bit_width(u)];
+        }
+        return _sizes[std::bit_width(u)];
+    }
 }
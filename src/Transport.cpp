@@ -2,7 +2,9 @@
 // Copyright (c) 2015-2022 mumlib2 contributors
 
 //stdlib
+#include <algorithm>
 #include <map>
+#include <span>
 #include <thread>
 
 //mumlib
@@ -13,6 +15,7 @@
 using namespace std::literals::chrono_literals;
 
 static auto PING_INTERVAL = 4s;
+static auto TICK_INTERVAL = 10ms;
 const long CLIENT_VERSION = 0x01020A;
 const std::string CLIENT_RELEASE("Mumlib2");
 const std::string CLIENT_OS("OS Unknown");
@@ -31,21 +34,33 @@ static std::map<MumbleProto::Reject_RejectType, std::string> rejectMessages = {
 };
 
 namespace mumlib2 {
+
+	// number of transport callbacks running on this thread, see disconnect()
+	static thread_local int callbackDepth = 0;
+
 	Transport::Transport(
+		asio::io_service& ioService,
+		bool sharedIo,
 		std::function<bool(MessageType, uint8_t*, int)> processMessageFunc,
-		std::function<bool(AudioPacket&)> processEncodedAudioPacketFunction,
+		std::function<bool(const AudioPacketView&)> processEncodedAudioPacketFunction,
+		std::function<bool()> processTickFunction,
+		std::function<void()> processMaintenanceFunction,
 		std::string cert_file,
 		std::string privkey_file) :
 		logger("mumlib.Transport"),
+		ioService(ioService),
+		strand(asio::make_strand(ioService)),
+		sharedIo(sharedIo),
 		processMessageFunction(std::move(processMessageFunc)),
 		processEncodedAudioPacketFunction(std::move(processEncodedAudioPacketFunction)),
-		udpSocket(ioService),
+		processTickFunction(std::move(processTickFunction)),
+		processMaintenanceFunction(std::move(processMaintenanceFunction)),
+		udpSocket(strand),
 		sslContext(asio::ssl::context::sslv23),
 		sslContextHelper(sslContext, cert_file, privkey_file),
-		sslSocket(ioService, sslContext),
-		pingTimer(ioService, std::chrono::seconds(PING_INTERVAL)) {
-
-		pingTimer.async_wait(std::bind(&Transport::pingTimerTick, this, std::placeholders::_1));
+		sslSocket(strand, sslContext),
+		pingTimer(strand),
+		tickTimer(strand) {
 	}
 
 	Transport::~Transport() {
@@ -58,6 +73,7 @@ namespace mumlib2 {
 
 		std::error_code errorCode;
 
+		callbackEnabled = true;
 		connectionParams = make_pair(host, port);
 		credentials = make_pair(user, password);
 		udpActive = false;
@@ -78,6 +94,9 @@ namespace mumlib2 {
 			asio::ip::udp::resolver::query queryUdp(asio::ip::udp::v4(), host, std::to_string(port));
 			udpReceiverEndpoint = *resolverUdp.resolve(queryUdp);
 			udpSocket.open(asio::ip::udp::v4());
+#if defined(MUMLIB2_UDP_MMSG)
+			udpSocket.non_blocking(true);
+#endif
 
 			std::array<char, 1> send_buf = { 0 };
 			udpSocket.send_to(asio::buffer(send_buf), udpReceiverEndpoint);
@@ -92,8 +111,10 @@ namespace mumlib2 {
 			async_connect(
 				sslSocket.lowest_layer(),
 				resolverTcp.resolve(queryTcp),
-				bind(&Transport::sslConnectHandler, this, std::placeholders::_1));
+				bind(&Transport::sslConnectHandler, shared_from_this(), std::placeholders::_1));
 
+			pingTimer.expires_after(PING_INTERVAL);
+			pingTimer.async_wait(std::bind(&Transport::pingTimerTick, shared_from_this(), std::placeholders::_1));
 		}
 		catch (std::runtime_error& exp) {
 			logger.log("Mumlib2::Transport::connect() -> failed to establish connection", exp.what());
@@ -105,15 +126,63 @@ namespace mumlib2 {
 	{
 		logger.log("Mumlib2::Transport::disconnect()");
 
+		//detach the callbacks; on the strand or inside any callback there is
+		//nothing to wait for, or waiting could deadlock
+		if (strand.running_in_this_thread() || callbackDepth > 0) {
+			callbackEnabled = false;
+		}
+		else {
+			std::lock_guard<std::mutex> lock(callbackMutex);
+			callbackEnabled = false;
+		}
+
+		//on a shared io_service the sockets are only touched from the strand,
+		//the handler keeps the transport alive
+		if (sharedIo && !strand.running_in_this_thread()) {
+			asio::post(strand, [self = shared_from_this()]() {
+				self->disconnectInternal();
+			});
+			return;
+		}
+
+		disconnectInternal();
+	}
+
+	template<typename F, typename R>
+	R Transport::invokeCallback(F&& fn, R detached)
+	{
+		std::lock_guard<std::mutex> lock(callbackMutex);
+		if (!callbackEnabled) {
+			return detached;
+		}
+
+		struct DepthGuard {
+			DepthGuard() { callbackDepth++; }
+			~DepthGuard() { callbackDepth--; }
+		} depth;
+
+		return fn();
+	}
+
+	void Transport::disconnectInternal()
+	{
 		state = ConnectionState::DISCONNECTING;
 
-		ioService.stop();
+		if (!sharedIo) {
+			ioService.stop();
+		}
 
 		if (state != ConnectionState::NOT_CONNECTED) {
 			std::error_code errorCode;
 
 			// todo perform different operations for each ConnectionState
+			pingTimer.cancel();
+			tickTimer.cancel();
 			sslSocket.lowest_layer().close(errorCode);
+			sslWriteQueue.Clear();
+#if defined(MUMLIB2_UDP_MMSG)
+			udpBatch.Clear(udpPool);
+#endif
 
 			udpSocket.shutdown(asio::ip::udp::socket::shutdown_both, errorCode);
 			udpSocket.close(errorCode);
@@ -178,12 +247,78 @@ namespace mumlib2 {
 		return udpActive;
 	}
 
+#if defined(MUMLIB2_UDP_MMSG)
+	void Transport::doReceiveUdp()
+	{
+		udpSocket.async_wait(
+			asio::ip::udp::socket::wait_read,
+			[this, self = shared_from_this()](const std::error_code& ec) {
+				if (!ec) {
+					receiveUdpBatch();
+					doReceiveUdp();
+				}
+				else if (ec == asio::error::operation_aborted) {
+					logger.warn("UDP receive function cancelled.");
+				}
+				else {
+					throwTransportException("UDP receive failed: " + ec.message());
+				}
+			});
+	}
+
+	void Transport::receiveUdpBatch()
+	{
+		std::error_code ec;
+		size_t count;
+
+		//drain the socket, one recvmmsg() and one decryptBatch() per RecvBatchSize datagrams
+		while ((count = udpBatch.Receive(udpSocket.native_handle(), ec)) > 0) {
+			if (!cryptState.isValid()) {
+				throwTransportException("received UDP packet before: CRYPT SETUP message");
+			}
+
+			lastReceivedUdpPacketTimestamp = std::chrono::system_clock::now();
+
+			if (udpActive == false) {
+				udpActive = true;
+				logger.warn("UDP is up.");
+			}
+
+			std::array<CryptBatchItem, TransportUdpBatch::RecvBatchSize> items;
+			for (size_t i = 0; i < count; i++) {
+				auto datagram = udpBatch.Datagram(i);
+				items[i].source = datagram.data();
+				items[i].dst = udpPlainBuffers[i].data();
+				items[i].crypted_length = static_cast<unsigned int>(datagram.size());
+			}
+
+			cryptState.decryptBatch(items.data(), count);
+			cryptStatsUpdate();
+
+			for (size_t i = 0; i < count; i++) {
+				if (!items[i].ok) {
+					throwTransportException("UDP packet: decryption failed");
+				}
+
+				processAudioPacketInternal(std::span<const uint8_t>(udpPlainBuffers[i].data(), items[i].crypted_length - 4));
+			}
+
+			if (count < TransportUdpBatch::RecvBatchSize) {
+				break;
+			}
+		}
+
+		if (ec) {
+			throwTransportException("UDP receive failed: " + ec.message());
+		}
+	}
+#else
 	void Transport::doReceiveUdp()
 	{
 		udpSocket.async_receive_from(
 			asio::buffer(udpIncomingBuffer, MUMBLE_UDP_MAXLENGTH),
 			udpReceiverEndpoint,
-			[this](const std::error_code& ec, size_t bytesTransferred) {
+			[this, self = shared_from_this()](const std::error_code& ec, size_t bytesTransferred) {
 				if (!ec && bytesTransferred > 0) {
 					logger.warn("Received UDP packet of %d B.", bytesTransferred);
 
@@ -198,18 +333,18 @@ namespace mumlib2 {
 							logger.warn("UDP is up.");
 						}
 
-						uint8_t plainBuffer[1024];
-						const int plainBufferLength = static_cast<const int>(bytesTransferred - 4);
+						uint8_t plainBuffer[MUMBLE_UDP_MAXLENGTH];
+						const size_t plainBufferLength = bytesTransferred - 4;
 
 						bool success = cryptState.decrypt(
 							udpIncomingBuffer, plainBuffer, static_cast<unsigned int>(bytesTransferred));
+						cryptStatsUpdate();
 
 						if (!success) {
 							throwTransportException("UDP packet: decryption failed");
 						}
 
-						auto packet = AudioPacket::Decode(plainBuffer, plainBufferLength, 0);
-						processEncodedAudioPacketFunction(packet);
+						processAudioPacketInternal(std::span<const uint8_t>(plainBuffer, plainBufferLength));
 					}
 
 					doReceiveUdp();
@@ -226,11 +361,12 @@ namespace mumlib2 {
 				}
 			});
 	}
+#endif
 
 	void Transport::sslConnectHandler(const std::error_code& error) {
 		if (!error) {
 			sslSocket.async_handshake(asio::ssl::stream_base::client,
-				std::bind(&Transport::sslHandshakeHandler, this,
+				std::bind(&Transport::sslHandshakeHandler, shared_from_this(),
 					std::placeholders::_1));
 		}
 		else {
@@ -253,13 +389,21 @@ namespace mumlib2 {
 	}
 
 	void Transport::pingTimerTick(const std::error_code& e) {
+		if (e == asio::error::operation_aborted) {
+			return;
+		}
+
 		if (state == ConnectionState::CONNECTED) {
 
 			sendSslPing();
 
+			//the previous ping is unanswered, sendSslPing() disconnected
+			if (state != ConnectionState::CONNECTED) {
+				return;
+			}
+
 			using namespace std::chrono;
 
-			logger.warn("pingTimerTick: Sending UDP ping.");
 			sendUdpPing();
 
 			if (udpActive) {
@@ -269,16 +413,37 @@ namespace mumlib2 {
 				}
 			}
 
+			invokeCallback([this]() { processMaintenanceFunction(); return true; }, false);
 		}
 
-		if ((state == ConnectionState::NOT_CONNECTED) && (ping_state == PingState::PING)) {
-			logger.warn("pingTimerTick disconnect!.");
-			disconnect();
+		//the handler holds the transport, a disconnected one must not re-arm it
+		if (state != ConnectionState::CONNECTED && state != ConnectionState::IN_PROGRESS) {
+			return;
 		}
 
-		logger.warn("TimerTick!.");
 		pingTimer.expires_at(pingTimer.expires_at() + PING_INTERVAL);
-		pingTimer.async_wait(std::bind(&Transport::pingTimerTick, this, std::placeholders::_1));
+		pingTimer.async_wait(std::bind(&Transport::pingTimerTick, shared_from_this(), std::placeholders::_1));
+	}
+
+	void Transport::requestTick() {
+		if (tickActive || state == ConnectionState::NOT_CONNECTED) {
+			return;
+		}
+
+		tickActive = true;
+		tickTimer.expires_after(TICK_INTERVAL);
+		tickTimer.async_wait(std::bind(&Transport::tickTimerTick, shared_from_this(), std::placeholders::_1));
+	}
+
+	void Transport::tickTimerTick(const std::error_code& e) {
+		if (e == asio::error::operation_aborted || state == ConnectionState::NOT_CONNECTED || !invokeCallback(processTickFunction, false)) {
+			tickActive = false;
+			return;
+		}
+
+		//fixed cadence, independent of the handler run time
+		tickTimer.expires_at(tickTimer.expiry() + TICK_INTERVAL);
+		tickTimer.async_wait(std::bind(&Transport::tickTimerTick, shared_from_this(), std::placeholders::_1));
 	}
 
 	void Transport::sendUdpAsync(const uint8_t* buff, int length) {
@@ -286,19 +451,27 @@ namespace mumlib2 {
 			throwTransportException("maximum allowed: data length is %d" + std::to_string(MUMBLE_UDP_MAXLENGTH - 4));
 		}
 
-		const auto bufSize = std::max(MUMBLE_TCP_MAXLENGTH, MUMBLE_UDP_MAXLENGTH);
-		auto* encryptedMsgBuff = reinterpret_cast<uint8_t*>(std::malloc(bufSize));
-		const int encryptedMsgLength = length + 4;
+		auto* encryptedMsgBuff = udpPool.Acquire();
+		if (!encryptedMsgBuff) {
+			//pool is exhausted and configured to drop
+			return;
+		}
 
 		cryptState.encrypt(buff, encryptedMsgBuff, static_cast<unsigned int>(length));
 
-		//logger.warn("Sending %d B of data UDP asynchronously.", encryptedMsgLength);
+#if defined(MUMLIB2_UDP_MMSG)
+		//frames queued until the flush runs go out with a single sendmmsg()
+		if (udpBatch.Queue(encryptedMsgBuff, static_cast<size_t>(length + 4))) {
+			asio::post(strand, [this, self = shared_from_this()] { flushUdp(); });
+		}
+#else
+		//logger.warn("Sending %d B of data UDP asynchronously.", length + 4);
 
 		udpSocket.async_send_to(
 			asio::buffer(encryptedMsgBuff, static_cast<size_t>(length + 4)),
 			udpReceiverEndpoint,
-			[this, encryptedMsgBuff](const std::error_code& ec, size_t bytesTransferred) {
-				std::free(encryptedMsgBuff);
+			[this, self = shared_from_this(), encryptedMsgBuff](const std::error_code& ec, size_t bytesTransferred) {
+				udpPool.Release(encryptedMsgBuff);
 				if (!ec && bytesTransferred > 0) {
 					//logger.warn("Sent %d B via UDP.", bytesTransferred);
 				}
@@ -306,6 +479,47 @@ namespace mumlib2 {
 					throwTransportException("UDP send failed: " + ec.message());
 				}
 			});
+#endif
+	}
+
+#if defined(MUMLIB2_UDP_MMSG)
+	void Transport::flushUdp() {
+		std::error_code ec;
+
+		if (udpBatch.Flush(udpSocket.native_handle(), udpReceiverEndpoint.data(),
+			static_cast<socklen_t>(udpReceiverEndpoint.size()), udpPool, ec)) {
+			return;
+		}
+
+		if (ec) {
+			throwTransportException("UDP send failed: " + ec.message());
+		}
+
+		//socket buffer is full, continue once it is writable again
+		udpSocket.async_wait(
+			asio::ip::udp::socket::wait_write,
+			[this, self = shared_from_this()](const std::error_code& ec) {
+				if (!ec) {
+					flushUdp();
+				}
+			});
+	}
+#endif
+
+	UdpPoolStats Transport::getUdpPoolStats() const {
+		return udpPool.GetStats();
+	}
+
+	UdpBatchStats Transport::getUdpBatchStats() const {
+#if defined(MUMLIB2_UDP_MMSG)
+		return udpBatch.GetStats();
+#else
+		return {};
+#endif
+	}
+
+	void Transport::setUdpPoolFallback(UdpPoolFallback fallback) {
+		udpPool.SetFallback(fallback);
 	}
 
 	void Transport::doReceiveSsl() {
@@ -330,7 +544,7 @@ namespace mumlib2 {
 
 				return remaining;
 			},
-			[this](const std::error_code& ec, size_t bytesTransferred) {
+			[this, self = shared_from_this()](const std::error_code& ec, size_t bytesTransferred) {
 				if (!ec && bytesTransferred > 0) {
 
 					int messageType = ntohs(*reinterpret_cast<uint16_t*>(sslIncomingBuffer.data()));
@@ -355,11 +569,15 @@ namespace mumlib2 {
 	}
 
 	void Transport::processMessageInternal(MessageType messageType, uint8_t* buffer, int length) {
+		//late completion after disconnect(), the owner may already be gone
+		if (state == ConnectionState::NOT_CONNECTED) {
+			return;
+		}
+
 		switch (messageType) {
 
 		case MessageType::UDPTUNNEL: {
-			auto packet = AudioPacket::Decode(buffer, length, 0);
-			processEncodedAudioPacketFunction(packet);
+			processAudioPacketInternal(std::span<const uint8_t>(buffer, static_cast<size_t>(length)));
 		}
 								   break;
 		case MessageType::AUTHENTICATE: {
@@ -414,7 +632,7 @@ namespace mumlib2 {
 
 			logger.warn("SERVERSYNC. Calling external ProcessControlMessageFunction.");
 
-			processMessageFunction(messageType, buffer, length);
+			invokeCallback([&]() { return processMessageFunction(messageType, buffer, length); }, false);
 		}
 									break;
 		case MessageType::CRYPTSETUP: {
@@ -445,88 +663,134 @@ namespace mumlib2 {
 									break;
 		default: {
 			logger.warn("Calling external ProcessControlMessageFunction.");
-			processMessageFunction(messageType, buffer, length);
+			invokeCallback([&]() { return processMessageFunction(messageType, buffer, length); }, false);
 		}
 			   break;
 		}
 	}
 
-	void Transport::sendUdpPing()
-	{
-		auto packet = AudioPacket::CreatePingPacket(time(nullptr)).Encode();
-		sendUdpAsync(packet.data(), packet.size());
-	}
-
-	void Transport::sendSsl(uint8_t* buff, int length) {
-		if (!buff || !length) {
+	void Transport::processAudioPacketInternal(std::span<const uint8_t> buffer) {
+		if (state == ConnectionState::NOT_CONNECTED) {
 			return;
 		}
 
-		if (length > MUMBLE_TCP_MAXLENGTH) {
-			logger.warn("Sending %d B of data via SSL. Maximal allowed data length to receive is %d B.", length, MUMBLE_TCP_MAXLENGTH);
-		}
-
 		try {
-			write(sslSocket, asio::buffer(buff, static_cast<size_t>(length)));
+			auto packet = AudioPacketView::Decode(buffer);
+			if (invokeCallback([&]() { return processEncodedAudioPacketFunction(packet); }, false)) {
+				requestTick();
+			}
 		}
-		catch (std::system_error& err) {
-			logger.log("Mumlib2::Transport::sendSsl() -> failed to send packet with error #", err.code());
-			disconnect();
-			state = ConnectionState::FAILED;
+		catch (const AudioPacketException& exp) {
+			logger.log("Mumlib2::Transport::processAudioPacketInternal() -> malformed packet dropped: ", exp.what());
 		}
 	}
 
-	void Transport::sendSslAsync(uint8_t* buff, int length) {
-		if (length > MUMBLE_TCP_MAXLENGTH) {
-			logger.warn("Sending %d B of data via SSL. Maximal allowed data length to receive is %d B.", length,
-				MUMBLE_TCP_MAXLENGTH);
-		}
+	void Transport::sendUdpPing()
+	{
+		std::array<uint8_t, 1 + VarInt::MaxSize> packet;
+		auto length = AudioPacket::EncodePingInto(packet, time(nullptr));
+		sendUdpAsync(packet.data(), static_cast<int>(length));
+	}
 
-		const auto bufSize = std::max(MUMBLE_TCP_MAXLENGTH, MUMBLE_UDP_MAXLENGTH);
-		auto* asyncBuff = reinterpret_cast<uint8_t*>(std::malloc(bufSize));
-		memcpy(asyncBuff, buff, static_cast<size_t>(length));
+	void Transport::scheduleWriteSsl() {
+		asio::post(strand, [this, self = shared_from_this()]() { doWriteSsl(); });
+	}
 
-		//logger.warn("Sending %d B of data asynchronously.", length);
+	void Transport::doWriteSsl() {
+		if (!sslWriteQueue.BeginWrite(sslWriteBuffers)) {
+			return;
+		}
 
 		async_write(
 			sslSocket,
-			asio::buffer(asyncBuff, static_cast<size_t>(length)),
-			[this, asyncBuff](const std::error_code& ec, size_t bytesTransferred) {
-				std::free(asyncBuff);
-				if (ec || !bytesTransferred) {
-					throwTransportException("async SSL send failed: " + ec.message());
+			std::span<const asio::const_buffer>(sslWriteBuffers),
+			[this, self = shared_from_this()](const std::error_code& ec, size_t bytesTransferred) {
+				sslWriteQueue.EndWrite();
+				if (ec) {
+					logger.log("Mumlib2::Transport::doWriteSsl() -> failed to send packet with error #", ec);
+					if (ec != asio::error::operation_aborted) {
+						disconnect();
+						state = ConnectionState::FAILED;
+					}
+					return;
 				}
+
+				doWriteSsl();
 			}
 		);
 	}
 
-	void Transport::sendControlMessage(MessageType type, google::protobuf::Message& message) {
-		if (state != ConnectionState::CONNECTED) {
-			logger.warn("sendControlMessage: Connection not established.");
-			return;
-		}
-		sendControlMessagePrivate(type, message);
+	WriteQueueStats Transport::getSslWriteQueueStats() const {
+		return sslWriteQueue.GetStats();
+	}
+
+	void Transport::setSslWriteHighwater(size_t highwater) {
+		sslWriteQueue.SetHighwater(highwater);
 	}
 
-	void Transport::sendControlMessagePrivate(MessageType type, google::protobuf::Message& message) {
+	ConnectionStats Transport::getStats() const {
+		ConnectionStats stats;
+		stats.state = state;
+		stats.udp_active = udpActive;
+
+		auto queueStats = sslWriteQueue.GetStats();
+		stats.tcp_messages = queueStats.messages;
+		stats.tcp_rejected = queueStats.rejected;
+		stats.tcp_queued_bytes = queueStats.queued_bytes;
+
+		auto poolStats = udpPool.GetStats();
+		stats.udp_sent = poolStats.acquired + poolStats.fallback_allocated;
+		stats.udp_dropped = poolStats.dropped;
+
+		stats.udp_good = cryptGood.load(std::memory_order_relaxed);
+		stats.udp_late = cryptLate.load(std::memory_order_relaxed);
+		stats.udp_lost = cryptLost.load(std::memory_order_relaxed);
+		stats.udp_resync = cryptResync.load(std::memory_order_relaxed);
+		return stats;
+	}
 
+	void Transport::cryptStatsUpdate() {
+		cryptGood.store(cryptState.getGood(), std::memory_order_relaxed);
+		cryptLate.store(cryptState.getLate(), std::memory_order_relaxed);
+		cryptLost.store(cryptState.getLost(), std::memory_order_relaxed);
+		cryptResync.store(cryptState.getResync(), std::memory_order_relaxed);
+	}
 
-		const uint16_t type_network = htons(static_cast<uint16_t>(type));
+	bool Transport::sendControlMessage(MessageType type, google::protobuf::Message& message) {
+		if (state != ConnectionState::CONNECTED) {
+			logger.warn("sendControlMessage: Connection not established.");
+			return false;
+		}
+		return sendControlMessagePrivate(type, message);
+	}
 
-		const int size = message.ByteSizeLong();
-		const uint32_t size_network = htonl((uint32_t)size);
+	bool Transport::sendControlMessagePrivate(MessageType type, google::protobuf::Message& message) {
+		const size_t size = message.ByteSizeLong();
+		const size_t length = sizeof(uint16_t) + sizeof(uint32_t) + size;
 
-		const int length = sizeof(type_network) + sizeof(size_network) + size;
+		if (length > MUMBLE_TCP_MAXLENGTH) {
+			logger.log("Mumlib2::Transport::sendControlMessagePrivate() -> message exceeds maximum length: ", length);
+			return false;
+		}
 
-		uint8_t buff[MUMBLE_UDP_MAXLENGTH];
+		//frame and serialize in place, ByteSizeLong() above has cached the sizes
+		bool queued = sslWriteQueue.Emplace(length, false, [&](uint8_t* out) {
+			const uint16_t type_network = htons(static_cast<uint16_t>(type));
+			const uint32_t size_network = htonl(static_cast<uint32_t>(size));
 
-		memcpy(buff, &type_network, sizeof(type_network));
+			memcpy(out, &type_network, sizeof(type_network));
+			memcpy(out + sizeof(type_network), &size_network, sizeof(size_network));
 
-		memcpy(buff + sizeof(type_network), &size_network, sizeof(size_network));
+			message.SerializeWithCachedSizesToArray(out + sizeof(type_network) + sizeof(size_network));
+		});
 
-		message.SerializeToArray(buff + sizeof(type_network) + sizeof(size_network), size);
+		if (!queued) {
+			logger.log("Mumlib2::Transport::sendControlMessagePrivate() -> write queue is above the high-water mark, message dropped");
+			return false;
+		}
 
-		sendSsl(buff, length);
+		scheduleWriteSsl();
+		return true;
 	}
 
 	void Transport::throwTransportException(std::string message) {
@@ -535,28 +799,64 @@ namespace mumlib2 {
 		throw TransportException(std::move(message));
 	}
 
-	void Transport::sendEncodedAudioPacket(const uint8_t* buffer, int length) {
+	bool Transport::sendEncodedAudioPacket(const uint8_t* buffer, int length) {
 		if (state != ConnectionState::CONNECTED) {
 			logger.warn("sendEncodedAudioPacket: Connection not established.");
-			return;
+			return false;
 		}
 
 		if (udpActive) {
 			sendUdpAsync(buffer, length);
+			return true;
 		}
 		else {
 			const uint16_t netUdptunnelType = htons(static_cast<uint16_t>(MessageType::UDPTUNNEL));
 			const uint32_t netLength = htonl(static_cast<uint32_t>(length));
 
-			const int packet = sizeof(netUdptunnelType) + sizeof(netLength) + length;
+			const size_t packetLength = sizeof(netUdptunnelType) + sizeof(netLength) + length;
 
-			uint8_t packetBuff[MUMBLE_UDP_MAXLENGTH];
+			bool queued = sslWriteQueue.Emplace(packetLength, true, [&](uint8_t* out) {
+				memcpy(out, &netUdptunnelType, sizeof(netUdptunnelType));
+				memcpy(out + sizeof(netUdptunnelType), &netLength, sizeof(netLength));
+				memcpy(out + sizeof(netUdptunnelType) + sizeof(netLength), buffer, static_cast<size_t>(length));
+			});
 
-			memcpy(packetBuff, &netUdptunnelType, sizeof(netUdptunnelType));
-			memcpy(packetBuff + sizeof(netUdptunnelType), &netLength, sizeof(netLength));
-			memcpy(packetBuff + sizeof(netUdptunnelType) + sizeof(netLength), buffer, static_cast<size_t>(length));
+			if (!queued) {
+				return false;
+			}
 
-			sendSsl(packetBuff, length + sizeof(netUdptunnelType) + sizeof(netLength));
+			scheduleWriteSsl();
+			return true;
 		}
 	}
-}
\ No newline at end of file
+
+	bool Transport::postEncodedAudioPacket(std::span<const uint8_t> packet) {
+		//not on the strand, the connection state is left alone
+		if (packet.size() > MUMBLE_UDP_MAXLENGTH - 4) {
+			logger.log("Mumlib2::Transport::postEncodedAudioPacket() -> packet dropped, length: ", std::to_string(packet.size()));
+			return false;
+		}
+
+		auto* slot = udpPool.Acquire();
+		if (!slot) {
+			//pool is exhausted and configured to drop
+			return false;
+		}
+
+		std::copy(packet.begin(), packet.end(), slot);
+		asio::post(strand, [this, self = shared_from_this(), slot, length = packet.size()]() {
+			//the slot is returned before sendUdpAsync() takes one for the ciphertext
+			uint8_t plain[MUMBLE_UDP_MAXLENGTH];
+			std::copy_n(slot, length, plain);
+			udpPool.Release(slot);
+
+			try {
+				sendEncodedAudioPacket(plain, static_cast<int>(length));
+			}
+			catch (const TransportException& exp) {
+				logger.log("Mumlib2::Transport::postEncodedAudioPacket() -> ", exp.what());
+			}
+		});
+		return true;
+	}
+}
@@ -6,162 +6,174 @@
 #include "mumlib2_private/varint.h"
 
 namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
     VarInt::VarInt(const uint8_t* buf)
     {
-        parse(buf);
+        _size = DecodeUnchecked(buf, _val);
     }
 
-    VarInt::VarInt(int8_t val) {
-        _val = val;
+    VarInt::VarInt(std::span<const uint8_t> buf)
+    {
+        _size = Decode(buf, _val);
+        if (!_size) {
+            throw VarIntException("truncated or malformed varint");
+        }
     }
 
-    VarInt::VarInt(int16_t val) {
-        _val = val;
+    VarInt::VarInt(int8_t val) : VarInt(static_cast<int64_t>(val))
+    {
     }
 
-    VarInt::VarInt(int32_t val)
+    VarInt::VarInt(int16_t val) : VarInt(static_cast<int64_t>(val))
     {
-        _val = val;
     }
 
-    VarInt::VarInt(uint32_t val)
+    VarInt::VarInt(int32_t val) : VarInt(static_cast<int64_t>(val))
+    {
+    }
+
+    VarInt::VarInt(uint32_t val) : VarInt(static_cast<int64_t>(val))
     {
-        _val = val;
     }
 
     VarInt::VarInt(int64_t val)
     {
         _val = val;
+        _size = EncodedSize(val);
     }
 
+    //
+    // Getters
+    //
+
     size_t VarInt::Size() const
     {
         return _size;
     }
 
-    size_t VarInt::Value() const
+    int64_t VarInt::Value() const
     {
         return _val;
     }
 
+    //
+    // Encode
+    //
+
     std::vector<uint8_t> VarInt::Encode() const
     {
-        std::vector<uint8_t> result;
+        std::vector<uint8_t> result(EncodedSize(_val));
+        EncodeUnchecked(_val, result.data());
+        return result;
+    }
 
-        if (_val < 0) {
-            throw VarIntException("currently negative not supported");
+    size_t VarInt::EncodeInto(std::span<uint8_t> out) const
+    {
+        if (out.size() < EncodedSize(_val)) {
+            throw VarIntException("output buffer too small");
         }
 
-        //7 bit positive (0xxxxxxx)
-        if (_val < 0x80) {
-            result.reserve(1);
-            result.push_back(_val & 0x7F);
-            return result;
-        }
+        return EncodeUnchecked(_val, out.data());
+    }
 
-        //14 bit positive (10xxxxxx + 1b)
-        if (_val < 0x4000) {
-            result.reserve(2);
-            result.push_back(static_cast<uint8_t&&>(0x80 | (_val >> 8)));
-            result.push_back(static_cast<uint8_t&&>(_val & 0xFF));
-            return result;
+    size_t VarInt::EncodeUnchecked(int64_t val, uint8_t* out)
+    {
+        auto u = static_cast<uint64_t>(val);
+        size_t pos = 0;
+
+        //negative numbers which fit into 32 bits once inverted
+        if (val < 0 && ~u < 0x100000000ULL) {
+            u = ~u;
+            if (u <= 0x3) {
+                out[0] = static_cast<uint8_t>(0xFC | u);
+                return 1;
+            }
+            out[pos++] = 0xF8;
         }
 
-        //21 bit positive (110xxxxx + 2b)
-        if (_val < 0x200000) {
-            result.reserve(3);
-            result.push_back(static_cast<uint8_t&&>(0xC0 | (_val >> 16)));
-            result.push_back(static_cast<uint8_t&&>((_val >> 8) & 0xFF));
-            result.push_back(static_cast<uint8_t&&>(_val & 0xFF));
-            return result;
+        size_t width = _sizes[std::bit_width(u)];
+        size_t tail = width - 1;
+
+        //prefix: 1..4 byte forms carry the high bits, 32/64 bit forms carry none
+        uint8_t prefix;
+        switch (width) {
+        case 5:
+            prefix = 0xF0;
+            break;
+        case 9:
+            prefix = 0xF4;
+            break;
+        default:
+            prefix = static_cast<uint8_t>((0xFF00 >> tail) | (u >> (8 * tail)));
+            break;
         }
+        out[pos++] = prefix;
 
-        //28 bit positive (1110xxxx + 3b)
-        else if (_val < 0x10000000) {
-            result.reserve(4);
-            result.push_back(static_cast<uint8_t&&>(0xE0 | (_val >> 24)));
-            result.push_back(static_cast<uint8_t&&>((_val >> 16) & 0xFF));
-            result.push_back(static_cast<uint8_t&&>((_val >> 8) & 0xFF));
-            result.push_back(static_cast<uint8_t&&>(_val & 0xFF));
-            return result;
+        //big endian tail
+        for (size_t i = tail; i > 0; i--) {
+            out[pos++] = static_cast<uint8_t>(u >> (8 * (i - 1)));
         }
 
-        //64 bit positive (111100__ + int64)
-        result.reserve(9);
-        result.push_back(0xF4);
-        result.push_back((_val >> 56) & 0xFF);
-        result.push_back((_val >> 48) & 0xFF);
-        result.push_back((_val >> 40) & 0xFF);
-        result.push_back((_val >> 32) & 0xFF);
-        result.push_back((_val >> 24) & 0xFF);
-        result.push_back((_val >> 16) & 0xFF);
-        result.push_back((_val >> 8) & 0xFF);
-        result.push_back((_val >> 0) & 0xFF);
-
-        return result;
+        return pos;
     }
 
-    void VarInt::parse(const uint8_t* buf)
+    //
+    // Decode
+    //
+
+    size_t VarInt::DecodeUnchecked(const uint8_t* buf, int64_t& val)
     {
-        _val = buf[0];
-        _size = 0;
-
-        //7 bit positive (0xxxxxxx)
-        if ((buf[0] & 0b1000'0000) == 0b0000'0000) {
-            _val = _val & 0b0111'1111;
-            _size = 1;
-            return;
+        const auto& format = _formats[buf[0]];
+
+        switch (format.kind) {
+        case Kind::Positive: {
+            uint64_t u = buf[0] & format.mask;
+            for (size_t i = 1; i < format.width; i++) {
+                u = (u << 8) | buf[i];
+            }
+            val = static_cast<int64_t>(u);
+            return format.width;
         }
-
-        //14 bit positive (10xxxxxx + 1b)
-        if ((buf[0] & 0b1100'0000) == 0b1000'0000) {
-            _val = ((_val & 0b0011'1111) << 8) | buf[1];
-            _size = 2;
-            return;
+        case Kind::NegativeRecursive: {
+            int64_t inner = 0;
+            auto size = DecodeUnchecked(buf + 1, inner);
+            val = ~inner;
+            return 1 + size;
         }
-
-        //21 bit positive (110xxxxx + 2b)
-        if ((buf[0] & 0b1110'0000) == 0b1100'0000) {
-            _val = ((_val & 0b0001'1111) << 16) | (buf[1] << 8) | buf[2];
-            _size = 3;
-            return;
+        case Kind::NegativeTwoBit:
+        default:
+            val = ~static_cast<int64_t>(buf[0] & format.mask);
+            return 1;
         }
+    }
 
-        //28 bit positive (1110xxxx + 3b)
-        if ((buf[0] & 0b1111'0000) == 0b1110'0000) {
-            _val = ((_val & 0b0000'1111) << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
-            _size = 4;
-            return;
+    size_t VarInt::Decode(std::span<const uint8_t> buf, int64_t& val)
+    {
+        if (buf.empty()) {
+            return 0;
         }
 
-        //32 bit positive (111100__ + int)
-        if ((buf[0] & 0b1111'1100) == 0b1111'0000) {
-            _val = _byteswap_uint64(*reinterpret_cast<const int32_t*>(buf + 1));
-            _size = 5;
-            return;
-        }
+        const auto& format = _formats[buf[0]];
 
-        //64 bit positive (111100__ + int64)
-        if ((buf[0] & 0b1111'1100) == 0b1111'0100) {
-            _val = _byteswap_uint64(*reinterpret_cast<const int64_t*>(buf + 1));
-            _size = 9;
-            return;
-        }
+        if (format.kind == Kind::NegativeRecursive) {
+            //only a single level of negation is meaningful
+            if (buf.size() < 2) {
+                return 0;
+            }
 
-        //negative recursive
-        if ((buf[0] & 0b1111'1100) == 0b1111'1000) {
-            _val = 0;
-            _size = 0;
-            throw VarIntException("currently negative recursive aren't supported");
-            return;
+            const auto& inner = _formats[buf[1]];
+            if (inner.kind != Kind::Positive || buf.size() < 1u + inner.width) {
+                return 0;
+            }
+        }
+        else if (buf.size() < format.width) {
+            return 0;
         }
 
-        //negative two bit
-        if ((buf[0] & 0b1111'1100) == 0b1111'1100) {
-            _val = 0;
-            _size = 0;
-            throw VarIntException("currently negative twobits aren't supported");
-            return;
-        } 
+        return DecodeUnchecked(buf.data(), val);
     }
 }
@@ -4,6 +4,7 @@
 //stdlib
 #include <array>
 #include <chrono>
+#include <thread>
 
 //mumlib
 #include "mumlib2/constants.h"
@@ -16,34 +17,417 @@ namespace mumlib2 {
     // Ctor/Dtor
     //
 
-    AudioDecoder::AudioDecoder(uint32_t channels)
+    AudioDecoder::AudioDecoder(uint32_t channels, uint32_t samplerate) : _mixer(channels, samplerate, AudioMixerConfig())
     {
         _channels = channels;
+        _samplerate = samplerate;
     }
 
     AudioDecoder::~AudioDecoder() {
     }
 
-    std::pair<const int16_t*, size_t> AudioDecoder::Process(const AudioPacket& packet)
+    //
+    // Processing
+    //
+
+    bool AudioDecoder::Process(const AudioPacketView& packet, const AudioDecoderSink& sink)
     {
-        //cleanup
-        auto current_time = std::chrono::steady_clock::now();
-        for (auto it = _sessions.begin(); it != _sessions.end();)
+        bool result = true;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto collect = pendingSink();
+            auto& session = acquire(packet.GetAudioSessionId());
+            if (!_jitter_config.enabled) {
+                if (_workers) {
+                    workerQueue(session.GetSessionId(), packet, collect);
+                }
+                else {
+                    session.Process(packet, mixSink(collect));
+
+                    //the mixer still runs on the tick clock
+                    result = _mixer.IsEnabled();
+                }
+            }
+            else {
+                session.Push(packet);
+            }
+        }
+
+        pendingDeliver(sink, nullptr);
+        return result;
+    }
+
+    bool AudioDecoder::Tick(const AudioDecoderSink& sink, const AudioMixerSink& mix_sink)
+    {
+        bool active = false;
         {
-            if ((current_time - it->second->GetLastTimepoint()) > _timeout_inactivity) {
-                _sessions.erase(it++);
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto collect = pendingSink();
+            auto session_sink = mixSink(collect);
+            if (_workers) {
+                active |= workerRun(session_sink);
             }
             else {
-                ++it;
+                for (auto& session : _sessions) {
+                    active |= session->Tick(session_sink);
+                }
+            }
+
+            active |= _mixer.Tick(pendingMixSink());
+        }
+
+        pendingDeliver(sink, &mix_sink);
+        return active;
+    }
+
+    AudioDecoderSink AudioDecoder::mixSink(const AudioDecoderSink& sink)
+    {
+        if (!_mixer.IsEnabled()) {
+            return sink;
+        }
+
+        return [this, &sink](const AudioDecoderFrame& frame) {
+            sink(frame);
+
+            auto channel_id = _mixer_channel_function ? _mixer_channel_function(frame.session_id) : -1;
+            _mixer.Push(channel_id, frame.session_id, frame.pcm, frame.samples);
+        };
+    }
+
+    AudioDecoderSink AudioDecoder::pendingSink()
+    {
+        //frames left over by an exception are dropped
+        _pending_frames_count = 0;
+        _pending_mixes_count = 0;
+
+        return [this](const AudioDecoderFrame& frame) {
+            if (_pending_frames_count == _pending_frames.size()) {
+                _pending_frames.emplace_back();
+            }
+
+            auto& pending = _pending_frames[_pending_frames_count++];
+            pending.frame = frame;
+            if (frame.pcm) {
+                pending.pcm.assign(frame.pcm, frame.pcm + frame.samples * _channels);
+            }
+        };
+    }
+
+    AudioMixerSink AudioDecoder::pendingMixSink()
+    {
+        return [this](const AudioMixerFrame& frame) {
+            if (_pending_mixes_count == _pending_mixes.size()) {
+                _pending_mixes.emplace_back();
+            }
+
+            auto& pending = _pending_mixes[_pending_mixes_count++];
+            pending.frame = frame;
+            if (frame.pcm) {
+                pending.pcm.assign(frame.pcm, frame.pcm + frame.samples * _channels);
+            }
+        };
+    }
+
+    void AudioDecoder::pendingDeliver(const AudioDecoderSink& sink, const AudioMixerSink* mix_sink)
+    {
+        //without _mutex; Process() and Tick() both run on the transport strand
+        for (size_t i = 0; i < _pending_frames_count; i++) {
+            auto frame = _pending_frames[i].frame;
+            if (frame.pcm) {
+                frame.pcm = _pending_frames[i].pcm.data();
+            }
+            sink(frame);
+        }
+        _pending_frames_count = 0;
+
+        for (size_t i = 0; mix_sink && i < _pending_mixes_count; i++) {
+            auto frame = _pending_mixes[i].frame;
+            if (frame.pcm) {
+                frame.pcm = _pending_mixes[i].pcm.data();
+            }
+            (*mix_sink)(frame);
+        }
+        _pending_mixes_count = 0;
+    }
+
+    //
+    // Sessions
+    //
+
+    void AudioDecoder::Evict()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        //backwards, release() moves the last session into the freed position
+        auto current_time = std::chrono::steady_clock::now();
+        for (size_t position = _sessions.size(); position-- > 0;) {
+            if ((current_time - _sessions[position]->GetLastTimepoint()) > _timeout_inactivity) {
+                release(position);
+            }
+        }
+    }
+
+    void AudioDecoder::Release(int32_t session_id)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto position = locate(session_id);
+        if (position) {
+            release(position - 1);
+        }
+    }
+
+    AudioDecoderSession& AudioDecoder::acquire(int32_t session_id)
+    {
+        auto position = locate(session_id);
+        if (position) {
+            return *_sessions[position - 1];
+        }
+
+        std::unique_ptr<AudioDecoderSession> session;
+        if (!_pool.empty()) {
+            session = std::move(_pool.back());
+            _pool.pop_back();
+            session->Recycle(session_id);
+        }
+        else {
+            session = std::make_unique<AudioDecoderSession>(session_id, _channels, _samplerate, _resampler_quality, _jitter_config);
+        }
+
+        _sessions.push_back(std::move(session));
+        index(session_id, _sessions.size());
+        return *_sessions.back();
+    }
+
+    void AudioDecoder::release(size_t position)
+    {
+        auto session = std::move(_sessions[position]);
+        auto session_id = session->GetSessionId();
+
+        _mixer.Remove(session_id);
+        index(session_id, 0);
+
+        //keep the list dense
+        if (position + 1 != _sessions.size()) {
+            _sessions[position] = std::move(_sessions.back());
+            index(_sessions[position]->GetSessionId(), position + 1);
+        }
+        _sessions.pop_back();
+
+        if (_pool.size() < _pool_max) {
+            _pool.push_back(std::move(session));
+        }
+    }
+
+    size_t AudioDecoder::locate(int32_t session_id) const
+    {
+        if (session_id >= 0 && session_id < _sessions_indexed_max) {
+            return static_cast<size_t>(session_id) < _sessions_index.size() ? _sessions_index[session_id] : 0;
+        }
+
+        auto it = _sessions_index_sparse.find(session_id);
+        return it != _sessions_index_sparse.end() ? it->second : 0;
+    }
+
+    void AudioDecoder::index(int32_t session_id, size_t position)
+    {
+        if (session_id >= 0 && session_id < _sessions_indexed_max) {
+            if (static_cast<size_t>(session_id) >= _sessions_index.size()) {
+                _sessions_index.resize(session_id + 1, 0);
+            }
+            _sessions_index[session_id] = position;
+        }
+        else if (position) {
+            _sessions_index_sparse[session_id] = position;
+        }
+        else {
+            _sessions_index_sparse.erase(session_id);
+        }
+    }
+
+    //
+    // Jitter buffer
+    //
+
+    void AudioDecoder::SetJitterConfig(const JitterBufferConfig& config)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _jitter_config = config;
+        for (auto& session : _sessions) {
+            session->SetJitterConfig(config);
+        }
+        for (auto& session : _pool) {
+            session->SetJitterConfig(config);
+        }
+    }
+
+    std::vector<JitterBufferStats> AudioDecoder::GetJitterStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        std::vector<JitterBufferStats> result;
+        result.reserve(_sessions.size());
+        for (const auto& session : _sessions) {
+            result.push_back(session->GetJitterStats());
+        }
+        return result;
+    }
+
+    //
+    // Resampling
+    //
+
+    void AudioDecoder::SetOutputSamplerate(uint32_t samplerate, uint32_t quality)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _samplerate = samplerate;
+        _resampler_quality = quality;
+        for (auto& session : _sessions) {
+            session->SetOutputSamplerate(samplerate, quality);
+        }
+        for (auto& session : _pool) {
+            session->SetOutputSamplerate(samplerate, quality);
+        }
+        _mixer.SetSamplerate(samplerate);
+    }
+
+    //
+    // Mixer
+    //
+
+    void AudioDecoder::SetMixerConfig(const AudioMixerConfig& config, std::function<int32_t(int32_t)> channel_function)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _mixer.SetConfig(config);
+        _mixer_channel_function = std::move(channel_function);
+    }
+
+    void AudioDecoder::SetMixerGain(int32_t session_id, float gain)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _mixer.SetGain(session_id, gain);
+    }
+
+    //
+    // Workers
+    //
+
+    void AudioDecoder::SetWorkers(uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        //packets still queued for the previous workers are dropped
+        _workers.reset();
+        _worker_shards.clear();
+
+        if (!count) {
+            return;
+        }
+
+        _worker_shards.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            _worker_shards.push_back(std::make_unique<WorkerShard>());
+        }
+        _workers = std::make_unique<AudioDecoderWorkers>(count);
+    }
+
+    void AudioDecoder::workerQueue(int32_t session_id, const AudioPacketView& packet, const AudioDecoderSink& sink)
+    {
+        auto& shard = *_worker_shards[static_cast<uint32_t>(session_id) % _worker_shards.size()];
+
+        auto* slot = shard.packets.Back();
+        if (!slot) {
+            //the shard is full, decode everything queued so far right away
+            workerRun(mixSink(sink));
+            slot = shard.packets.Back();
+        }
+
+        auto payload = packet.GetAudioPayload();
+        slot->session_id = session_id;
+        slot->target = packet.GetHeaderTarget();
+        slot->sequence = packet.GetAudioSequenceNumber();
+        slot->is_last = packet.GetAudioLastFlag();
+        slot->payload.assign(payload.begin(), payload.end());
+        shard.packets.Push();
+    }
+
+    bool AudioDecoder::workerRun(const AudioDecoderSink& sink)
+    {
+        //the sessions are only read by the workers until Run() returns
+        _workers->Run(
+            [this](size_t worker) { workerJob(worker); },
+            [this, &sink]() { return workerDrain(sink); }
+        );
+
+        bool active = false;
+        for (auto& shard : _worker_shards) {
+            active |= shard->active;
+        }
+        return active;
+    }
+
+    void AudioDecoder::workerJob(size_t worker)
+    {
+        auto& shard = *_worker_shards[worker];
+
+        auto sink = [this, &shard](const AudioDecoderFrame& frame) {
+            auto* slot = shard.frames.Back();
+            while (!slot) {
+                std::this_thread::yield();
+                slot = shard.frames.Back();
             }
+
+            slot->frame = frame;
+            if (frame.pcm) {
+                slot->pcm.assign(frame.pcm, frame.pcm + frame.samples * _channels);
+            }
+            shard.frames.Push();
+        };
+
+        //packets bypassing the jitter buffer
+        while (auto* packet = shard.packets.Front()) {
+            auto position = locate(packet->session_id);
+            if (position) {
+                try {
+                    _sessions[position - 1]->Process(packet->target, packet->sequence, packet->is_last, packet->payload, sink);
+                }
+                catch (const AudioDecoderException& exp) {
+                    _logger.log("Mumlib2::AudioDecoder::workerJob() -> frame dropped: ", exp.what());
+                }
+            }
+            shard.packets.Pop();
         }
 
-        //process
-        auto session_id = packet.GetAudioSessionId();
-        if (!_sessions.contains(session_id)) {
-            _sessions.emplace(session_id, std::make_unique<AudioDecoderSession>(session_id, _channels));
+        //jitter buffer playout
+        shard.active = false;
+        for (auto& session : _sessions) {
+            if (static_cast<uint32_t>(session->GetSessionId()) % _worker_shards.size() == worker) {
+                shard.active |= session->Tick(sink);
+            }
         }
+    }
+
+    bool AudioDecoder::workerDrain(const AudioDecoderSink& sink)
+    {
+        bool drained = false;
+        for (auto& shard : _worker_shards) {
+            while (auto* slot = shard->frames.Front()) {
+                auto frame = slot->frame;
+                if (frame.pcm) {
+                    frame.pcm = slot->pcm.data();
+                }
+                sink(frame);
 
-        return _sessions[session_id]->Process(packet);
+                shard->frames.Pop();
+                drained = true;
+            }
+        }
+        return drained;
     }
 }
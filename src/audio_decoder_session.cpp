@@ -1,19 +1,28 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // Copyright (c) 2015-2022 mumlib2 contributors
 
+//stdlib
+#include <algorithm>
+
 //mumlib
 #include "mumlib2/constants.h"
 #include "mumlib2/exceptions.h"
 #include "mumlib2_private/audio_decoder_session.h"
 
 namespace mumlib2 {
-	AudioDecoderSession::AudioDecoderSession(int32_t session_id, uint32_t channels)
+	AudioDecoderSession::AudioDecoderSession(int32_t session_id, uint32_t channels, uint32_t samplerate, uint32_t resampler_quality,
+	                                         const JitterBufferConfig& jitter_config)
+		: _jitter(jitter_config)
 	{
 		_session_id = session_id;
 		_channels = channels;
 
 		opusCreate();
 		opusResize();
+
+		SetOutputSamplerate(samplerate, resampler_quality);
+
+		_timepoint_last = std::chrono::steady_clock::now();
 	}
 
 	AudioDecoderSession::~AudioDecoderSession()
@@ -21,6 +30,27 @@ namespace mumlib2 {
 		opusDestroy();
 	}
 
+	void AudioDecoderSession::Recycle(int32_t session_id)
+	{
+		reset();
+		_jitter.Clear();
+
+		_session_id = session_id;
+		_sequence_next = -1;
+		_frame_units = 2;
+		_target_last = 0;
+
+		_stats_concealed = 0;
+		_stats_fec = 0;
+
+		_timepoint_last = std::chrono::steady_clock::now();
+	}
+
+	int32_t AudioDecoderSession::GetSessionId() const
+	{
+		return _session_id;
+	}
+
 	std::chrono::time_point<std::chrono::steady_clock> AudioDecoderSession::GetLastTimepoint()
 	{
 		return _timepoint_last;
@@ -37,13 +67,13 @@ namespace mumlib2 {
 		}
 	}
 
-	size_t AudioDecoderSession::opusDecode(const uint8_t* in_data, size_t in_len)
+	int AudioDecoderSession::opusDecode(const uint8_t* in_data, size_t in_len, size_t frame_size, bool fec)
 	{
 		if (!_opus) {
 			throw AudioDecoderException("opusDecode: no decoder");
 		}
 
-		return opus_decode(_opus, in_data, in_len, _opus_output_buf.data(), static_cast<int>(_opus_output_buf.size()), 0);
+		return opus_decode(_opus, in_data, static_cast<opus_int32>(in_len), _opus_output_buf.data(), static_cast<int>(frame_size), fec ? 1 : 0);
 	}
 
 	void AudioDecoderSession::opusDestroy()
@@ -62,6 +92,27 @@ namespace mumlib2 {
 		};
 	}
 
+	void AudioDecoderSession::SetOutputSamplerate(uint32_t samplerate, uint32_t quality)
+	{
+		_resampler.reset();
+		if (samplerate == MUMBLE_AUDIO_SAMPLERATE) {
+			return;
+		}
+
+		_resampler = std::make_unique<AudioResampler>(MUMBLE_AUDIO_SAMPLERATE, samplerate, _channels, quality);
+		_resampler_buf.resize(_resampler->MaxOutput(_opus_output_buf.size() / _channels) * _channels);
+	}
+
+	void AudioDecoderSession::emit(AudioDecoderFrame& frame, const AudioDecoderSink& sink)
+	{
+		if (_resampler && frame.pcm) {
+			frame.samples = _resampler->Process(frame.pcm, frame.samples, _resampler_buf.data());
+			frame.pcm = _resampler_buf.data();
+		}
+
+		sink(frame);
+	}
+
 	void AudioDecoderSession::reset()
 	{
 		if (!_opus) {
@@ -72,30 +123,155 @@ namespace mumlib2 {
 		if (status != OPUS_OK) {
 			throw AudioDecoderException("failed to reset encoder: 2");
 		}
+
+		if (_resampler) {
+			_resampler->Reset();
+		}
 	}
 
-	std::pair<const int16_t*, size_t> AudioDecoderSession::Process(const AudioPacket& packet)
+	void AudioDecoderSession::Process(const AudioPacketView& packet, const AudioDecoderSink& sink)
 	{
-		int16_t* result_data = nullptr;
-		size_t result_size = 0;
+		Process(packet.GetHeaderTarget(), packet.GetAudioSequenceNumber(), packet.GetAudioLastFlag(), packet.GetAudioPayload(), sink);
+	}
 
-		auto& payload = packet.GetAudioPayload();
-		if (payload.size()) {
-			result_size = opusDecode(payload.data(), payload.size());
-			result_data = _opus_output_buf.data();
+	void AudioDecoderSession::Process(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, const AudioDecoderSink& sink)
+	{
+		//conceal the frames skipped since the previous packet
+		if (_sequence_next >= 0 && sequence > _sequence_next && sequence - _sequence_next <= _conceal_max_units && payload.size()) {
+			try {
+				//extrapolate all but the frame right before this packet, that one is carried by its FEC data
+				auto position = _sequence_next;
+				while (sequence - position > _frame_units) {
+					conceal(target, position, _frame_units, {}, sink);
+					position += _frame_units;
+				}
+				conceal(target, position, static_cast<uint32_t>(sequence - position), payload, sink);
+			}
+			catch (const AudioDecoderException& exp) {
+				logger.log("Mumlib2::AudioDecoderSession::Process() -> concealment failed: ", exp.what());
+			}
+		}
 
-			if (result_size <= 0) {
+		decode(target, sequence, is_last, payload, sink);
+	}
+
+	void AudioDecoderSession::decode(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, const AudioDecoderSink& sink)
+	{
+		AudioDecoderFrame frame;
+		frame.target = target;
+		frame.session_id = _session_id;
+		frame.sequence_number = sequence;
+		frame.is_last = is_last;
+
+		if (payload.size()) {
+			int result = opusDecode(payload.data(), payload.size(), _opus_output_buf.size() / _channels, false);
+			if (result <= 0) {
 				throw AudioDecoderException("failed to decode opus data");
 			}
+
+			frame.pcm = _opus_output_buf.data();
+			frame.samples = static_cast<size_t>(result);
+
+			_frame_units = std::max<uint32_t>(static_cast<uint32_t>(result) / (MUMBLE_AUDIO_SAMPLERATE / 100), 1);
+			_sequence_next = sequence + _frame_units;
+			_target_last = target;
 		}
 
+		_timepoint_last = std::chrono::steady_clock::now();
+
+		emit(frame, sink);
+
 		//reset
-		if (packet.GetAudioLastFlag()) {
+		if (is_last) {
 			reset();
+			_sequence_next = -1;
+		}
+	}
+
+	void AudioDecoderSession::conceal(uint8_t target, int64_t sequence, uint32_t units, std::span<const uint8_t> next, const AudioDecoderSink& sink)
+	{
+		auto frame_size = std::min<size_t>(units * (MUMBLE_AUDIO_SAMPLERATE / 100), _opus_output_buf.size() / _channels);
+		if (!frame_size) {
+			return;
+		}
+
+		//the in-band FEC data of the following packet holds a low bitrate copy of
+		//the lost frame; without it the decoder falls back to PLC by itself
+		bool fec = !next.empty();
+		int result = opusDecode(fec ? next.data() : nullptr, fec ? next.size() : 0, frame_size, fec);
+		if (result <= 0) {
+			throw AudioDecoderException("failed to conceal lost opus frame");
+		}
+
+		_stats_concealed++;
+		_stats_fec += fec;
+		_sequence_next = sequence + units;
+
+		AudioDecoderFrame frame;
+		frame.target = target;
+		frame.session_id = _session_id;
+		frame.sequence_number = sequence;
+		frame.is_concealed = true;
+		frame.pcm = _opus_output_buf.data();
+		frame.samples = static_cast<size_t>(result);
+
+		emit(frame, sink);
+	}
+
+	//
+	// Jitter buffer
+	//
+
+	void AudioDecoderSession::Push(const AudioPacketView& packet)
+	{
+		auto payload = packet.GetAudioPayload();
+
+		//duration in sequence units of 10 ms
+		uint32_t units = 1;
+		if (payload.size()) {
+			int samples = opus_packet_get_nb_samples(payload.data(), static_cast<opus_int32>(payload.size()), MUMBLE_AUDIO_SAMPLERATE);
+			if (samples > 0) {
+				units = static_cast<uint32_t>(samples) / (MUMBLE_AUDIO_SAMPLERATE / 100);
+			}
 		}
 
 		_timepoint_last = std::chrono::steady_clock::now();
 
-		return std::make_pair(result_data, result_size);
+		_jitter.Push(packet.GetHeaderTarget(), packet.GetAudioSequenceNumber(), packet.GetAudioLastFlag(), payload, units, _timepoint_last);
+	}
+
+	bool AudioDecoderSession::Tick(const AudioDecoderSink& sink)
+	{
+		AudioJitterBuffer::Gap gap;
+
+		auto* entry = _jitter.Tick(gap);
+		try {
+			if (entry) {
+				decode(entry->target, entry->sequence, entry->is_last, entry->payload, sink);
+			}
+			else if (gap.missing) {
+				auto* next = _jitter.Peek(gap.sequence + gap.units);
+				conceal(_target_last, gap.sequence, gap.units, next ? std::span<const uint8_t>(next->payload) : std::span<const uint8_t>(), sink);
+			}
+		}
+		catch (const AudioDecoderException& exp) {
+			logger.log("Mumlib2::AudioDecoderSession::Tick() -> frame dropped: ", exp.what());
+		}
+
+		return _jitter.IsActive();
+	}
+
+	void AudioDecoderSession::SetJitterConfig(const JitterBufferConfig& config)
+	{
+		_jitter.SetConfig(config);
+	}
+
+	JitterBufferStats AudioDecoderSession::GetJitterStats() const
+	{
+		auto stats = _jitter.GetStats();
+		stats.session_id = _session_id;
+		stats.concealed = _stats_concealed;
+		stats.fec = _stats_fec;
+		return stats;
 	}
 }
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <exception>
+
+//mumlib
+#include "mumlib2_private/audio_decoder_workers.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor/Dtor
+    //
+
+    AudioDecoderWorkers::AudioDecoderWorkers(size_t count)
+    {
+        _threads.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            _threads.emplace_back(&AudioDecoderWorkers::threadRun, this, i);
+        }
+    }
+
+    AudioDecoderWorkers::~AudioDecoderWorkers()
+    {
+        _stop = true;
+        _generation.fetch_add(1, std::memory_order_release);
+        _generation.notify_all();
+
+        for (auto& thread : _threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    //
+    // Processing
+    //
+
+    void AudioDecoderWorkers::Run(const std::function<void(size_t)>& job, const std::function<bool()>& poll)
+    {
+        if (_threads.empty()) {
+            return;
+        }
+
+        _job = &job;
+        _pending.store(_threads.size(), std::memory_order_relaxed);
+        _generation.fetch_add(1, std::memory_order_release);
+        _generation.notify_all();
+
+        //consume results while the workers produce them
+        while (_pending.load(std::memory_order_acquire)) {
+            if (!poll()) {
+                std::this_thread::yield();
+            }
+        }
+
+        while (poll()) {
+        }
+
+        _job = nullptr;
+    }
+
+    void AudioDecoderWorkers::threadRun(size_t worker)
+    {
+        uint64_t generation = 0;
+
+        while (true) {
+            _generation.wait(generation, std::memory_order_acquire);
+            generation = _generation.load(std::memory_order_acquire);
+
+            if (_stop) {
+                return;
+            }
+
+            try {
+                (*_job)(worker);
+            }
+            catch (const std::exception& exp) {
+                _logger.log("Mumlib2::AudioDecoderWorkers::threadRun() -> job failed: ", exp.what());
+            }
+
+            _pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    //
+    // Getters
+    //
+
+    size_t AudioDecoderWorkers::GetCount() const
+    {
+        return _threads.size();
+    }
+}
@@ -1,5 +1,7 @@
 //stdlib
+#include <algorithm>
 #include <array>
+#include <string>
 
 //mumlib
 #include "mumlib2/constants.h"
@@ -12,14 +14,10 @@ namespace mumlib2 {
     // Ctor/Dtor
     //
 
-    AudioEncoder::AudioEncoder(uint32_t output_bitrate) {
-        _channels = MUMBLE_AUDIO_CHANNELS;
+    AudioEncoder::AudioEncoder(uint32_t input_samplerate, const AudioEncoderProfile& profile) {
+        _input_samplerate = input_samplerate;
 
-        createOpus();
-
-        SetBitrate(output_bitrate);
-
-        reset();
+        SetProfile(profile);
     }
 
     AudioEncoder::~AudioEncoder() {
@@ -30,11 +28,23 @@ namespace mumlib2 {
     {
         destroyOpus();
 
+        int application = OPUS_APPLICATION_VOIP;
+        switch (_profile.application) {
+            case AudioApplication::VOIP:                application = OPUS_APPLICATION_VOIP; break;
+            case AudioApplication::AUDIO:               application = OPUS_APPLICATION_AUDIO; break;
+            case AudioApplication::RESTRICTED_LOWDELAY: application = OPUS_APPLICATION_RESTRICTED_LOWDELAY; break;
+        }
+
         int status = 0;
-        _encoder = opus_encoder_create(MUMBLE_AUDIO_SAMPLERATE, _channels, OPUS_APPLICATION_VOIP, &status);
+        _encoder = opus_encoder_create(MUMBLE_AUDIO_SAMPLERATE, _channels, application, &status);
         if (status != OPUS_OK) {
             throw AudioEncoderException(std::string("failed to initialize OPUS encoder: ") + opus_strerror(status));
         }
+
+        _repacketizer = opus_repacketizer_create();
+        if (!_repacketizer) {
+            throw AudioEncoderException("failed to initialize OPUS repacketizer");
+        }
     }
 
     void AudioEncoder::destroyOpus()
@@ -43,6 +53,11 @@ namespace mumlib2 {
             opus_encoder_destroy(_encoder);
             _encoder = nullptr;
         }
+
+        if (_repacketizer) {
+            opus_repacketizer_destroy(_repacketizer);
+            _repacketizer = nullptr;
+        }
     }
 
     void AudioEncoder::reset() {
@@ -56,73 +71,326 @@ namespace mumlib2 {
         }
 
         _sequence_number = 0;
+        _pcm_fill = 0;
+        _frames_pending = 0;
+        _active = false;
+
+        if (_resampler) {
+            _resampler->Reset();
+        }
+    }
+
+    void AudioEncoder::SetProfile(const AudioEncoderProfile& profile)
+    {
+        if (profile.channels != 1 && profile.channels != 2) {
+            throw AudioEncoderException("unsupported channel count: " + std::to_string(profile.channels));
+        }
+
+        bool recreate = !_encoder || profile.channels != _profile.channels || profile.application != _profile.application;
+
+        _profile = profile;
+        _profile.complexity = std::min(_profile.complexity, 10u);
+
+        if (recreate) {
+            _channels = _profile.channels;
+
+            createOpus();
+            SetInputSamplerate(_input_samplerate, _resampler_quality);
+            SetFrameSize(_frame_ms, _frames_per_packet);
+            SetFec(_fec);
+            SetPacketLoss(_packet_loss);
+
+            reset();
+        }
+
+        int bandwidth = OPUS_BANDWIDTH_FULLBAND;
+        switch (_profile.max_bandwidth) {
+            case AudioBandwidth::NARROWBAND:    bandwidth = OPUS_BANDWIDTH_NARROWBAND; break;
+            case AudioBandwidth::MEDIUMBAND:    bandwidth = OPUS_BANDWIDTH_MEDIUMBAND; break;
+            case AudioBandwidth::WIDEBAND:      bandwidth = OPUS_BANDWIDTH_WIDEBAND; break;
+            case AudioBandwidth::SUPERWIDEBAND: bandwidth = OPUS_BANDWIDTH_SUPERWIDEBAND; break;
+            case AudioBandwidth::FULLBAND:      bandwidth = OPUS_BANDWIDTH_FULLBAND; break;
+        }
+
+        int error = opus_encoder_ctl(_encoder, OPUS_SET_VBR(_profile.bitrate_mode != AudioBitrateMode::CBR ? 1 : 0));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize variable bitrate:") + opus_strerror(error));
+        }
+
+        error = opus_encoder_ctl(_encoder, OPUS_SET_VBR_CONSTRAINT(_profile.bitrate_mode == AudioBitrateMode::CVBR ? 1 : 0));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize constrained variable bitrate:") + opus_strerror(error));
+        }
+
+        error = opus_encoder_ctl(_encoder, OPUS_SET_COMPLEXITY(static_cast<int>(_profile.complexity)));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize complexity:") + opus_strerror(error));
+        }
+
+        error = opus_encoder_ctl(_encoder, OPUS_SET_MAX_BANDWIDTH(bandwidth));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize max bandwidth:") + opus_strerror(error));
+        }
+
+        error = opus_encoder_ctl(_encoder, OPUS_SET_DTX(_profile.dtx ? 1 : 0));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize DTX:") + opus_strerror(error));
+        }
+
+        SetBitrate(_profile.bitrate);
+    }
+
+    const AudioEncoderProfile& AudioEncoder::GetProfile() const
+    {
+        return _profile;
     }
 
     void AudioEncoder::SetBitrate(uint32_t bitrate)
     {
-        _encoder_buf.resize(bitrate * MUMBLE_OPUS_MAXLENGTH / 1000);
+        if (!_encoder) {
+            throw AudioEncoderException("failed to reset encoder");
+        }
+
+        //bitrate the frame budget can carry, Opus would otherwise lose quality
+        //hitting the cap on every frame
+        auto budget_bitrate = static_cast<uint32_t>(_frame_budget * 8 * 1000 / _frame_ms);
+        bitrate = std::min(bitrate, budget_bitrate);
+
+        int error = opus_encoder_ctl(_encoder, OPUS_SET_BITRATE(bitrate));
+        if (error != OPUS_OK) {
+            throw AudioEncoderException(std::string("failed to initialize transmission bitrate:") + opus_strerror(error));
+        }
+
+        _profile.bitrate = bitrate;
+    }
 
+    void AudioEncoder::SetFec(bool enabled)
+    {
         if (!_encoder) {
             throw AudioEncoderException("failed to reset encoder");
         }
 
-        int error = opus_encoder_ctl(_encoder, OPUS_SET_VBR(0));
+        int error = opus_encoder_ctl(_encoder, OPUS_SET_INBAND_FEC(enabled ? 1 : 0));
         if (error != OPUS_OK) {
-            throw AudioEncoderException(std::string("failed to initialize variable bitrate:") + opus_strerror(error));
+            throw AudioEncoderException(std::string("failed to set inband FEC:") + opus_strerror(error));
+        }
+
+        _fec = enabled;
+    }
+
+    void AudioEncoder::SetPacketLoss(uint32_t percent)
+    {
+        if (!_encoder) {
+            throw AudioEncoderException("failed to reset encoder");
         }
 
-        error = opus_encoder_ctl(_encoder, OPUS_SET_BITRATE(bitrate));
+        int error = opus_encoder_ctl(_encoder, OPUS_SET_PACKET_LOSS_PERC(static_cast<int>(std::min(percent, 100u))));
         if (error != OPUS_OK) {
-            throw AudioEncoderException(std::string("failed to initialize transmission bitrate:") + opus_strerror(error));
+            throw AudioEncoderException(std::string("failed to set expected packet loss:") + opus_strerror(error));
         }
+
+        _packet_loss = percent;
     }
 
-    std::vector<uint8_t> AudioEncoder::Encode(const int16_t* pcmData, size_t pcmLength, uint32_t target) {
-        const int16_t* in_data = pcmData;
-        int in_len = pcmLength;
+    void AudioEncoder::SetInputSamplerate(uint32_t samplerate, uint32_t quality)
+    {
+        _input_samplerate = samplerate;
+        _resampler_quality = quality;
 
-        int out_len = 0;
+        _resampler.reset();
+        if (samplerate != MUMBLE_AUDIO_SAMPLERATE) {
+            _resampler = std::make_unique<AudioResampler>(samplerate, MUMBLE_AUDIO_SAMPLERATE, _channels, quality);
+        }
+    }
+
+    uint32_t AudioEncoder::GetInputSamplerate() const
+    {
+        return _input_samplerate;
+    }
+
+    void AudioEncoder::SetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet)
+    {
+        if (frame_ms != 10 && frame_ms != 20 && frame_ms != 40 && frame_ms != 60) {
+            throw AudioEncoderException("unsupported frame size: " + std::to_string(frame_ms));
+        }
+
+        if (!frames_per_packet || frame_ms * frames_per_packet > MUMBLE_OPUS_MAXLENGTH) {
+            throw AudioEncoderException("packet duration exceeds " + std::to_string(MUMBLE_OPUS_MAXLENGTH) + " ms");
+        }
+
+        _frame_ms = frame_ms;
+        _frames_per_packet = frames_per_packet;
+        _frame_samples = MUMBLE_AUDIO_SAMPLERATE * frame_ms / 1000;
+
+        //the repacketizer adds up to 2 bytes per frame
+        _frame_budget = std::min(_frame_max_bytes, _packet_payload_max / frames_per_packet - 2);
+
+        _pcm_buf.resize(_frame_samples * _channels);
+        _pcm_fill = 0;
+
+        _encoder_buf.resize(_frame_max_bytes * frames_per_packet);
+        _repacketizer_buf.resize(_frame_max_bytes * frames_per_packet);
+        _frame_lengths.resize(frames_per_packet);
+        _frames_pending = 0;
+
+        if (_encoder) {
+            SetBitrate(_profile.bitrate);
+        }
+    }
+
+    uint32_t AudioEncoder::GetPacketDuration() const
+    {
+        return _frame_ms * _frames_per_packet;
+    }
+
+    void AudioEncoder::SetVadConfig(const AudioVadConfig& config)
+    {
+        _vad.SetConfig(config);
+    }
+
+    AudioVadStats AudioEncoder::GetVadStats() const
+    {
+        return _vad.GetStats();
+    }
+
+    //
+    // Encoding
+    //
+
+    void AudioEncoder::Encode(const int16_t* pcmData, size_t pcmLength, uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink)
+    {
+        if (!pcmData || !pcmLength) {
+            return;
+        }
 
         //check interval and reset encoder
-        auto interval = std::chrono::high_resolution_clock::now() - _sequence_timestemp;
+        auto interval = std::chrono::steady_clock::now() - _sequence_timestemp;
         if (interval > _sequence_reset_interval) {
             reset();
         }
-        
-        //resample and encode
-        if (pcmData && pcmLength) {
-            out_len = opus_encode(
-                _encoder,
-                in_data,
-                in_len,
-                _encoder_buf.data(),
-                _encoder_buf.size()
-            );
-
-            if (out_len <= 0) {
-                throw AudioEncoderException(std::string("failed to encode PCM data: %s") + opus_strerror(out_len));
+
+        if (_resampler) {
+            auto capacity = _resampler->MaxOutput(pcmLength) * _channels;
+            if (_resampler_buf.size() < capacity) {
+                _resampler_buf.resize(capacity);
             }
+
+            auto converted = _resampler->Process(pcmData, pcmLength, _resampler_buf.data());
+            accumulate(_resampler_buf.data(), converted, target, out, sink);
+        }
+        else {
+            accumulate(pcmData, pcmLength, target, out, sink);
         }
 
-        //create audiopacket
-        auto encoded = AudioPacket::CreateAudioOpusPacket(
-            target,
-            _sequence_number,
-            _encoder_buf.data(),
-            out_len,
-            out_len == 0).Encode();
+        _sequence_timestemp = std::chrono::steady_clock::now();
+    }
+
+    void AudioEncoder::accumulate(const int16_t* pcmData, size_t pcmLength, uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink)
+    {
+        while (pcmLength) {
+            const int16_t* frame = nullptr;
 
-        //update timestamp and sequence
-        if (out_len > 0) {
-            //1 per 10ms
-            _sequence_number += 100 * in_len / MUMBLE_AUDIO_SAMPLERATE;
+            if (!_pcm_fill && pcmLength >= _frame_samples) {
+                //whole frame available, encode in place
+                frame = pcmData;
+                pcmData += _frame_samples * _channels;
+                pcmLength -= _frame_samples;
+            }
+            else {
+                auto count = std::min(pcmLength, _frame_samples - _pcm_fill);
+                std::copy_n(pcmData, count * _channels, _pcm_buf.begin() + _pcm_fill * _channels);
+                _pcm_fill += count;
+                pcmData += count * _channels;
+                pcmLength -= count;
+
+                if (_pcm_fill < _frame_samples) {
+                    break;
+                }
+
+                frame = _pcm_buf.data();
+                _pcm_fill = 0;
+            }
+
+            //silent frames are dropped, the first one ends the talk spurt
+            if (_vad.IsEnabled() && !_vad.Process(frame, _frame_samples * _channels, _frame_ms)) {
+                if (_frames_pending || _active) {
+                    endSpurt(target, out, sink);
+                }
+                continue;
+            }
+
+            encodeFrame(frame);
+            if (_frames_pending == _frames_per_packet) {
+                emitPacket(target, false, out, sink);
+            }
         }
-        else {
-            reset();
+    }
+
+    void AudioEncoder::Flush(uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink)
+    {
+        if (_pcm_fill) {
+            std::fill(_pcm_buf.begin() + _pcm_fill * _channels, _pcm_buf.end(), 0);
+            _pcm_fill = 0;
+            encodeFrame(_pcm_buf.data());
         }
 
+        endSpurt(target, out, sink);
         _sequence_timestemp = std::chrono::steady_clock::now();
+    }
+
+    void AudioEncoder::endSpurt(uint32_t target, std::span<uint8_t> out, const AudioEncoderSink& sink)
+    {
+        //the terminator flag rides on the last packet, or on an empty one
+        if (_frames_pending || _active) {
+            emitPacket(target, true, out, sink);
+        }
+
+        reset();
+    }
+
+    void AudioEncoder::encodeFrame(const int16_t* pcm)
+    {
+        auto* frame_out = _encoder_buf.data() + _frames_pending * _frame_max_bytes;
+
+        auto len = opus_encode(_encoder, pcm, static_cast<int>(_frame_samples), frame_out, static_cast<opus_int32>(_frame_budget));
+        if (len <= 0) {
+            throw AudioEncoderException(std::string("failed to encode PCM data: ") + opus_strerror(len));
+        }
+
+        _frame_lengths[_frames_pending++] = len;
+    }
+
+    void AudioEncoder::emitPacket(uint32_t target, bool is_last, std::span<uint8_t> out, const AudioEncoderSink& sink)
+    {
+        std::span<const uint8_t> payload;
+
+        if (_frames_pending == 1) {
+            payload = std::span<const uint8_t>(_encoder_buf.data(), _frame_lengths[0]);
+        }
+        else if (_frames_pending > 1) {
+            //merge the frames into one multi-frame Opus packet
+            opus_repacketizer_init(_repacketizer);
+            for (uint32_t i = 0; i < _frames_pending; i++) {
+                int status = opus_repacketizer_cat(_repacketizer, _encoder_buf.data() + i * _frame_max_bytes, _frame_lengths[i]);
+                if (status != OPUS_OK) {
+                    throw AudioEncoderException(std::string("failed to repacketize frames: ") + opus_strerror(status));
+                }
+            }
+
+            auto len = opus_repacketizer_out(_repacketizer, _repacketizer_buf.data(), static_cast<opus_int32>(_repacketizer_buf.size()));
+            if (len <= 0) {
+                throw AudioEncoderException(std::string("failed to repacketize frames: ") + opus_strerror(len));
+            }
+            payload = std::span<const uint8_t>(_repacketizer_buf.data(), len);
+        }
+
+        auto encoded_len = AudioPacket::EncodeOpusInto(out, target, _sequence_number, payload, is_last);
+
+        //1 per 10ms
+        _sequence_number += _frames_pending * _frame_ms / 10;
+        _frames_pending = 0;
+        _active = true;
 
-        return encoded;
+        sink(std::span<const uint8_t>(out.data(), encoded_len));
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <chrono>
+
+//mumlib
+#include "mumlib2/constants.h"
+#include "mumlib2/exceptions.h"
+#include "mumlib2_private/audio_input.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    static AudioInputChunk chunkPrototype(size_t samples, uint32_t channels)
+    {
+        AudioInputChunk chunk;
+        chunk.pcm.resize(samples * channels);
+        return chunk;
+    }
+
+    AudioInput::AudioInput(asio::io_service& io, const AudioInputConfig& config, uint32_t samplerate, AudioInputSink sink)
+        : _config(config),
+          _chunk_samples(std::max<size_t>(std::max(samplerate, MUMBLE_AUDIO_SAMPLERATE) * std::max(config.chunk_ms, 1u) / 1000, 1)),
+          _strand(asio::make_strand(io)),
+          _timer(_strand),
+          _queue(config.chunks, chunkPrototype(_chunk_samples, _channels_max)),
+          _sink(std::move(sink))
+    {
+        _config.poll_ms = std::max(_config.poll_ms, 1u);
+    }
+
+    void AudioInput::Start()
+    {
+        asio::post(_strand, [this, self = shared_from_this()]() { schedule(); });
+    }
+
+    void AudioInput::Stop()
+    {
+        //waits for a drain in progress
+        std::lock_guard<std::mutex> lock(_sink_mutex);
+        _sink = nullptr;
+
+        asio::post(_strand, [this, self = shared_from_this()]() { _timer.cancel(); });
+    }
+
+    void AudioInput::schedule()
+    {
+        _timer.expires_after(std::chrono::milliseconds(_config.poll_ms));
+        _timer.async_wait([this, self = shared_from_this()](const std::error_code& ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+
+            drain();
+
+            std::lock_guard<std::mutex> lock(_sink_mutex);
+            if (_sink) {
+                schedule();
+            }
+        });
+    }
+
+    //
+    // Producer
+    //
+
+    bool AudioInput::Push(const int16_t* pcm, size_t samples, uint32_t channels, uint32_t target)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        bool complete = true;
+        channels = std::clamp(channels, 1u, _channels_max);
+
+        while (samples) {
+            auto* slot = _queue.Back();
+            if (!slot) {
+                _stats_dropped.fetch_add(1, std::memory_order_relaxed);
+                complete = false;
+                break;
+            }
+
+            auto count = std::min(samples, _chunk_samples);
+            std::copy_n(pcm, count * channels, slot->pcm.begin());
+            slot->samples = count;
+            slot->channels = channels;
+            slot->target = target;
+            slot->flush = false;
+            _queue.Push();
+            _stats_pushed.fetch_add(1, std::memory_order_relaxed);
+
+            pcm += count * channels;
+            samples -= count;
+        }
+
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        _stats_calls.fetch_add(1, std::memory_order_relaxed);
+        _stats_push_ns.fetch_add(elapsed, std::memory_order_relaxed);
+        if (elapsed > _stats_push_ns_max.load(std::memory_order_relaxed)) {
+            _stats_push_ns_max.store(elapsed, std::memory_order_relaxed);
+        }
+
+        return complete;
+    }
+
+    bool AudioInput::PushFlush(uint32_t target)
+    {
+        auto* slot = _queue.Back();
+        if (!slot) {
+            _stats_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slot->samples = 0;
+        slot->target = target;
+        slot->flush = true;
+        _queue.Push();
+        _stats_pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //
+    // Consumer
+    //
+
+    void AudioInput::drain()
+    {
+        std::lock_guard<std::mutex> lock(_sink_mutex);
+        if (!_sink) {
+            return;
+        }
+
+        while (auto* slot = _queue.Front()) {
+            //a chunk the encoder fails on is dropped, the queue keeps draining
+            try {
+                _sink(*slot);
+            }
+            catch (const Mumlib2Exception& exp) {
+                _stats_failed.fetch_add(1, std::memory_order_relaxed);
+                _logger.log("Mumlib2::AudioInput::drain() -> chunk dropped: ", exp.what());
+            }
+
+            _queue.Pop();
+            _stats_encoded.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    //
+    // Getters
+    //
+
+    AudioInputStats AudioInput::GetStats() const
+    {
+        AudioInputStats stats;
+        stats.pushed = _stats_pushed.load(std::memory_order_relaxed);
+        stats.dropped = _stats_dropped.load(std::memory_order_relaxed);
+        stats.encoded = _stats_encoded.load(std::memory_order_relaxed);
+        stats.failed = _stats_failed.load(std::memory_order_relaxed);
+        stats.depth = static_cast<uint32_t>(_queue.Size());
+
+        auto calls = _stats_calls.load(std::memory_order_relaxed);
+        stats.push_ns_max = _stats_push_ns_max.load(std::memory_order_relaxed);
+        stats.push_ns_avg = calls ? _stats_push_ns.load(std::memory_order_relaxed) / calls : 0;
+        return stats;
+    }
+}
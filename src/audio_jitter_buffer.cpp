@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+
+//mumlib
+#include "mumlib2_private/audio_jitter_buffer.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    AudioJitterBuffer::AudioJitterBuffer(const JitterBufferConfig& config) : _epoch(std::chrono::steady_clock::now())
+    {
+        SetConfig(config);
+    }
+
+    void AudioJitterBuffer::SetConfig(const JitterBufferConfig& config)
+    {
+        _config = config;
+        _config.percentile = std::min(_config.percentile, 100u);
+        _config.delay_max_ms = std::clamp(_config.delay_max_ms, TickMs, static_cast<uint32_t>(Capacity / 2 * TickMs));
+        _config.delay_min_ms = std::clamp(_config.delay_min_ms, TickMs, _config.delay_max_ms);
+
+        _target = std::clamp(_target, _config.delay_min_ms / TickMs, _config.delay_max_ms / TickMs);
+    }
+
+    void AudioJitterBuffer::Clear()
+    {
+        reset();
+
+        _last_units = 2;
+        _target = std::clamp(2u, _config.delay_min_ms / TickMs, _config.delay_max_ms / TickMs);
+        _epoch = std::chrono::steady_clock::now();
+        _stats = {};
+    }
+
+    //
+    // Producer
+    //
+
+    bool AudioJitterBuffer::Push(uint8_t target, int64_t sequence, bool is_last, std::span<const uint8_t> payload, uint32_t units,
+                                 std::chrono::steady_clock::time_point now)
+    {
+        _stats.received++;
+        units = std::max(units, 1u);
+
+        if (!_count && !_playing) {
+            //idle, this is the start of a new stream
+            _play_seq = sequence;
+            _end_seq = sequence;
+        }
+        else if (sequence < _play_seq) {
+            if (_play_seq - sequence < static_cast<int64_t>(Capacity) && _playing) {
+                _stats.late++;
+                return false;
+            }
+
+            if (_playing || _end_seq - sequence > static_cast<int64_t>(Capacity)) {
+                //far behind the playout position, the sender restarted its numbering
+                reset();
+                _end_seq = sequence;
+            }
+            _play_seq = sequence;
+        }
+        else if (sequence + units - _play_seq > static_cast<int64_t>(Capacity)) {
+            //too far ahead to be buffered, restarted numbering or a long gap
+            reset();
+            _play_seq = sequence;
+            _end_seq = sequence;
+        }
+
+        auto& entry = slot(sequence);
+        if (entry.valid) {
+            if (entry.sequence == sequence) {
+                _stats.dropped++;
+                return false;
+            }
+            evict(entry);
+        }
+
+        entry.sequence = sequence;
+        entry.units = units;
+        entry.target = target;
+        entry.is_last = is_last;
+        entry.payload.assign(payload.begin(), payload.end());
+        entry.valid = true;
+
+        _count++;
+        _count_last += is_last;
+        _end_seq = std::max(_end_seq, sequence + units);
+
+        updateTarget(sequence, units, now);
+        return true;
+    }
+
+    void AudioJitterBuffer::updateTarget(int64_t sequence, uint32_t units, std::chrono::steady_clock::time_point now)
+    {
+        //arrival time relative to the send time implied by the sequence number;
+        //the spread of this value is the jitter the buffer has to absorb
+        auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - _epoch).count();
+        _delays[_delays_pos] = now_ms - sequence * TickMs;
+        _delays_pos = (_delays_pos + 1) % _delays.size();
+        _delays_count = std::min(_delays_count + 1, _delays.size());
+
+        std::array<int64_t, std::tuple_size_v<decltype(_delays)>> sorted;
+        std::copy_n(_delays.begin(), _delays_count, sorted.begin());
+
+        auto begin = sorted.begin();
+        auto end = begin + _delays_count;
+        auto nth = begin + (_delays_count - 1) * _config.percentile / 100;
+        auto lowest = *std::min_element(begin, end);
+        std::nth_element(begin, nth, end);
+
+        auto target_ms = static_cast<uint32_t>(std::max<int64_t>(*nth - lowest, 0)) + units * TickMs;
+        target_ms = std::clamp(target_ms, _config.delay_min_ms, _config.delay_max_ms);
+
+        _target = (target_ms + TickMs - 1) / TickMs;
+    }
+
+    //
+    // Consumer
+    //
+
+    const AudioJitterBuffer::Entry* AudioJitterBuffer::Tick(Gap& gap)
+    {
+        gap = Gap();
+
+        if (!_playing) {
+            //start once the target delay is covered or a complete talk spurt is buffered
+            if (!_count || (GetDepth() < _target && !_count_last)) {
+                return nullptr;
+            }
+            _playing = true;
+            _remaining = 0;
+        }
+
+        auto* entry = &slot(_play_seq);
+        if (entry->valid && entry->sequence != _play_seq) {
+            //stale entry left behind by an inconsistent sender
+            _stats.dropped++;
+            evict(*entry);
+        }
+
+        //previous frame is still playing
+        if (_remaining) {
+            if (entry->valid) {
+                _stats.dropped++;
+                evict(*entry);
+            }
+            _remaining--;
+            _play_seq++;
+            return nullptr;
+        }
+
+        //skip frames while the buffer holds clearly more than the target
+        while (entry->valid && !entry->is_last && GetDepth() >= entry->units + _target + _shrink_hysteresis) {
+            _stats.dropped++;
+            _play_seq += entry->units;
+            evict(*entry);
+            entry = &slot(_play_seq);
+            if (entry->valid && entry->sequence != _play_seq) {
+                _stats.dropped++;
+                evict(*entry);
+            }
+        }
+
+        if (entry->valid) {
+            _remaining = entry->units - 1;
+            _last_units = entry->units;
+            _play_seq++;
+            _stats.played++;
+
+            evict(*entry);
+
+            //end of the talk spurt, the next one is buffered again
+            if (entry->is_last) {
+                _playing = false;
+            }
+            return entry;
+        }
+
+        if (!_count) {
+            _stats.underruns++;
+            _playing = false;
+            return nullptr;
+        }
+
+        //gap in front of buffered packets
+        gap.missing = true;
+        gap.sequence = _play_seq;
+        gap.units = _last_units;
+        _stats.lost++;
+        _remaining = _last_units - 1;
+        _play_seq++;
+        return nullptr;
+    }
+
+    const AudioJitterBuffer::Entry* AudioJitterBuffer::Peek(int64_t sequence) const
+    {
+        const auto& entry = _entries[static_cast<uint64_t>(sequence) % Capacity];
+        if (!entry.valid || entry.sequence != sequence) {
+            return nullptr;
+        }
+        return &entry;
+    }
+
+    //
+    // Slots
+    //
+
+    AudioJitterBuffer::Entry& AudioJitterBuffer::slot(int64_t sequence)
+    {
+        return _entries[static_cast<uint64_t>(sequence) % Capacity];
+    }
+
+    void AudioJitterBuffer::evict(Entry& entry)
+    {
+        entry.valid = false;
+        _count--;
+        _count_last -= entry.is_last;
+    }
+
+    void AudioJitterBuffer::reset()
+    {
+        for (auto& entry : _entries) {
+            entry.valid = false;
+        }
+        _count = 0;
+        _count_last = 0;
+
+        _playing = false;
+        _remaining = 0;
+
+        _delays_count = 0;
+        _delays_pos = 0;
+    }
+
+    //
+    // Getters
+    //
+
+    bool AudioJitterBuffer::IsActive() const
+    {
+        return _playing || _count;
+    }
+
+    uint32_t AudioJitterBuffer::GetDepth() const
+    {
+        if (!_count) {
+            return 0;
+        }
+        return static_cast<uint32_t>(std::max<int64_t>(_end_seq - _play_seq, 0));
+    }
+
+    uint32_t AudioJitterBuffer::GetTarget() const
+    {
+        return _target;
+    }
+
+    JitterBufferStats AudioJitterBuffer::GetStats() const
+    {
+        auto stats = _stats;
+        stats.depth_ms = GetDepth() * TickMs;
+        stats.target_ms = _target * TickMs;
+        return stats;
+    }
+}
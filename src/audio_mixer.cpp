@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+//mumlib
+#include "mumlib2_private/audio_mixer.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace mumlib2 {
+
+    //
+    // Kernels
+    //
+
+    // acc[i] += (in[i] * gain) >> 12
+    static void mixAccumulate(int32_t* acc, const int16_t* in, size_t count, int16_t gain_q12)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        const __m256i gain = _mm256_set1_epi16(gain_q12);
+        for (; i + 16 <= count; i += 16) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i lo = _mm256_mullo_epi16(x, gain);
+            __m256i hi = _mm256_mulhi_epi16(x, gain);
+
+            //unpack works per 128 bit lane, restore the sample order
+            __m256i p_lo = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 12);
+            __m256i p_hi = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 12);
+            __m256i p0 = _mm256_permute2x128_si256(p_lo, p_hi, 0x20);
+            __m256i p1 = _mm256_permute2x128_si256(p_lo, p_hi, 0x31);
+
+            auto* a = reinterpret_cast<__m256i*>(acc + i);
+            _mm256_storeu_si256(a, _mm256_add_epi32(_mm256_loadu_si256(a), p0));
+            _mm256_storeu_si256(a + 1, _mm256_add_epi32(_mm256_loadu_si256(a + 1), p1));
+        }
+#elif defined(__SSE2__)
+        const __m128i gain = _mm_set1_epi16(gain_q12);
+        for (; i + 8 <= count; i += 8) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i lo = _mm_mullo_epi16(x, gain);
+            __m128i hi = _mm_mulhi_epi16(x, gain);
+            __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 12);
+            __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 12);
+
+            auto* a = reinterpret_cast<__m128i*>(acc + i);
+            _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), p0));
+            _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), p1));
+        }
+#elif defined(__ARM_NEON)
+        for (; i + 8 <= count; i += 8) {
+            int16x8_t x = vld1q_s16(in + i);
+            int32x4_t p0 = vshrq_n_s32(vmull_n_s16(vget_low_s16(x), gain_q12), 12);
+            int32x4_t p1 = vshrq_n_s32(vmull_n_s16(vget_high_s16(x), gain_q12), 12);
+
+            vst1q_s32(acc + i, vaddq_s32(vld1q_s32(acc + i), p0));
+            vst1q_s32(acc + i + 4, vaddq_s32(vld1q_s32(acc + i + 4), p1));
+        }
+#endif
+
+        for (; i < count; i++) {
+            acc[i] += (static_cast<int32_t>(in[i]) * gain_q12) >> 12;
+        }
+    }
+
+    // out[i] = saturate16(acc[i])
+    static void mixStore(int16_t* out, const int32_t* acc, size_t count)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for (; i + 16 <= count; i += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 8));
+
+            //pack works per 128 bit lane, restore the sample order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+        }
+#elif defined(__SSE2__)
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+        }
+#elif defined(__ARM_NEON)
+        for (; i + 8 <= count; i += 8) {
+            int16x4_t a = vqmovn_s32(vld1q_s32(acc + i));
+            int16x4_t b = vqmovn_s32(vld1q_s32(acc + i + 4));
+            vst1q_s16(out + i, vcombine_s16(a, b));
+        }
+#endif
+
+        for (; i < count; i++) {
+            out[i] = static_cast<int16_t>(std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX));
+        }
+    }
+
+    //
+    // Ctor
+    //
+
+    AudioMixer::AudioMixer(uint32_t channels, uint32_t samplerate, const AudioMixerConfig& config) : _channels(channels), _samplerate(samplerate)
+    {
+        SetConfig(config);
+    }
+
+    void AudioMixer::SetConfig(const AudioMixerConfig& config)
+    {
+        _config = config;
+        _config.period_ms = std::clamp<uint32_t>(_config.period_ms / TickMs * TickMs, TickMs, 2 * TickMs);
+
+        auto samples = _config.period_ms * _samplerate / 1000 * _channels;
+        _accumulator.resize(samples);
+        _output.resize(samples);
+
+        if (!_config.enabled) {
+            _speakers.clear();
+            _mix_channels.clear();
+        }
+    }
+
+    void AudioMixer::SetSamplerate(uint32_t samplerate)
+    {
+        //queued audio is at the previous rate
+        _samplerate = samplerate;
+        _speakers.clear();
+
+        SetConfig(_config);
+    }
+
+    bool AudioMixer::IsEnabled() const
+    {
+        return _config.enabled;
+    }
+
+    void AudioMixer::SetGain(int32_t session_id, float gain)
+    {
+        auto gain_q12 = static_cast<int32_t>(std::lround(std::clamp(gain, 0.0f, 7.99f) * 4096.0f));
+        if (gain_q12 == 4096) {
+            _gains.erase(session_id);
+            return;
+        }
+        _gains[session_id] = gain_q12;
+    }
+
+    //
+    // Input
+    //
+
+    void AudioMixer::Push(int32_t channel_id, int32_t session_id, const int16_t* pcm, size_t samples)
+    {
+        if (!_config.enabled || !pcm || !samples) {
+            return;
+        }
+
+        auto& speaker = _speakers[session_id];
+        speaker.channel_id = channel_id;
+
+        //drop what was consumed, then the oldest samples beyond the limit
+        speaker.pcm.erase(speaker.pcm.begin(), speaker.pcm.begin() + speaker.offset);
+        speaker.offset = 0;
+        speaker.pcm.insert(speaker.pcm.end(), pcm, pcm + samples * _channels);
+
+        size_t limit = _speaker_max_ms * _samplerate / 1000 * _channels;
+        if (speaker.pcm.size() > limit) {
+            speaker.offset = speaker.pcm.size() - limit;
+        }
+    }
+
+    void AudioMixer::Remove(int32_t session_id)
+    {
+        _speakers.erase(session_id);
+    }
+
+    //
+    // Output
+    //
+
+    bool AudioMixer::Tick(const AudioMixerSink& sink)
+    {
+        if (!_config.enabled) {
+            return false;
+        }
+
+        _ticks++;
+        if (_ticks * TickMs >= _config.period_ms) {
+            _ticks = 0;
+            mix(sink);
+        }
+
+        return std::any_of(_speakers.begin(), _speakers.end(), [](const auto& entry) { return entry.second.Available() > 0; });
+    }
+
+    void AudioMixer::mix(const AudioMixerSink& sink)
+    {
+        //collect channels with queued audio
+        std::vector<int32_t> channel_ids;
+        for (const auto& [session_id, speaker] : _speakers) {
+            if (speaker.Available() && std::find(channel_ids.begin(), channel_ids.end(), speaker.channel_id) == channel_ids.end()) {
+                channel_ids.push_back(speaker.channel_id);
+            }
+        }
+
+        for (auto channel_id : channel_ids) {
+            std::fill(_accumulator.begin(), _accumulator.end(), 0);
+
+            uint32_t speakers = 0;
+            for (auto& [session_id, speaker] : _speakers) {
+                if (speaker.channel_id != channel_id || !speaker.Available()) {
+                    continue;
+                }
+
+                auto gain_it = _gains.find(session_id);
+                auto gain = static_cast<int16_t>(gain_it != _gains.end() ? gain_it->second : 4096);
+
+                //a speaker that ran short is padded with silence
+                auto count = std::min(speaker.Available(), _accumulator.size());
+                mixAccumulate(_accumulator.data(), speaker.pcm.data() + speaker.offset, count, gain);
+                speaker.offset += count;
+                speakers++;
+            }
+
+            auto& channel = _mix_channels[channel_id];
+            if (_config.limiter) {
+                limit(channel, _accumulator.size());
+            }
+            mixStore(_output.data(), _accumulator.data(), _output.size());
+
+            AudioMixerFrame frame;
+            frame.channel_id = channel_id;
+            frame.speakers = speakers;
+            frame.pcm = _output.data();
+            frame.samples = _output.size() / _channels;
+            sink(frame);
+        }
+    }
+
+    void AudioMixer::limit(Channel& channel, size_t samples)
+    {
+        int32_t peak = 0;
+        for (size_t i = 0; i < samples; i++) {
+            peak = std::max(peak, std::abs(_accumulator[i]));
+        }
+
+        //instant attack to keep the peak at the threshold, gradual release
+        int32_t target = 1 << 15;
+        if (peak > _limiter_threshold) {
+            target = static_cast<int32_t>((static_cast<int64_t>(_limiter_threshold) << 15) / peak);
+        }
+
+        int32_t from = channel.limiter_gain;
+        int32_t to = std::min(target, from + _limiter_release_q15);
+        if (to < from) {
+            from = to;
+        }
+        channel.limiter_gain = to;
+
+        if (from == (1 << 15) && to == (1 << 15)) {
+            return;
+        }
+
+        //ramp the gain over the period to avoid steps
+        for (size_t i = 0; i < samples; i++) {
+            int64_t gain = from + (static_cast<int64_t>(to - from) * static_cast<int64_t>(i)) / static_cast<int64_t>(samples);
+            _accumulator[i] = static_cast<int32_t>((static_cast<int64_t>(_accumulator[i]) * gain) >> 15);
+        }
+    }
+}
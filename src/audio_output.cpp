@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <utility>
+
+//mumlib
+#include "mumlib2_private/audio_output.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    AudioOutput::AudioOutput(const AudioOutputConfig& config, uint32_t channels)
+        : _config(config), _channels(channels), _queue(config.frames)
+    {
+    }
+
+    //
+    // Producer
+    //
+
+    void AudioOutput::Push(const AudioDecoderFrame& frame)
+    {
+        auto* slot = reserve(frame.pcm, frame.samples);
+        if (!slot) {
+            return;
+        }
+
+        slot->session_id = frame.session_id;
+        slot->channel_id = -1;
+        slot->speakers = 0;
+        slot->target = frame.target;
+        slot->sequence_number = frame.sequence_number;
+        slot->is_last = frame.is_last;
+        slot->is_concealed = frame.is_concealed;
+
+        _queue.Push();
+        _stats_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void AudioOutput::Push(const AudioMixerFrame& frame)
+    {
+        auto* slot = reserve(frame.pcm, frame.samples);
+        if (!slot) {
+            return;
+        }
+
+        slot->session_id = -1;
+        slot->channel_id = frame.channel_id;
+        slot->speakers = frame.speakers;
+        slot->target = 0;
+        slot->sequence_number = 0;
+        slot->is_last = false;
+        slot->is_concealed = false;
+
+        _queue.Push();
+        _stats_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    AudioOutputFrame* AudioOutput::reserve(const int16_t* pcm, size_t samples)
+    {
+        auto* slot = _queue.Back();
+        if (!slot) {
+            _stats_overflows.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        //the slot holds the buffer of a previously popped frame
+        if (pcm) {
+            slot->pcm.assign(pcm, pcm + samples * _channels);
+            slot->samples = samples;
+        }
+        else {
+            slot->pcm.clear();
+            slot->samples = 0;
+        }
+        slot->timestamp = std::chrono::steady_clock::now();
+
+        return slot;
+    }
+
+    //
+    // Consumer
+    //
+
+    bool AudioOutput::Pop(AudioOutputFrame& frame)
+    {
+        auto* slot = _queue.Front();
+        if (!slot) {
+            _stats_underflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        frame.session_id = slot->session_id;
+        frame.channel_id = slot->channel_id;
+        frame.speakers = slot->speakers;
+        frame.target = slot->target;
+        frame.sequence_number = slot->sequence_number;
+        frame.is_last = slot->is_last;
+        frame.is_concealed = slot->is_concealed;
+        frame.timestamp = slot->timestamp;
+        frame.samples = slot->samples;
+        std::swap(frame.pcm, slot->pcm);
+
+        _queue.Pop();
+        _stats_popped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //
+    // Getters
+    //
+
+    const AudioOutputConfig& AudioOutput::GetConfig() const
+    {
+        return _config;
+    }
+
+    AudioOutputStats AudioOutput::GetStats() const
+    {
+        AudioOutputStats stats;
+        stats.pushed = _stats_pushed.load(std::memory_order_relaxed);
+        stats.popped = _stats_popped.load(std::memory_order_relaxed);
+        stats.overflows = _stats_overflows.load(std::memory_order_relaxed);
+        stats.underflows = _stats_underflows.load(std::memory_order_relaxed);
+        stats.depth = static_cast<uint32_t>(_queue.Size());
+        return stats;
+    }
+}
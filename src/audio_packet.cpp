@@ -1,6 +1,10 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // Copyright (c) 2015-2022 mumlib2 contributors
 
+//stdlib
+#include <algorithm>
+
+//mumlib
 #include "mumlib2/exceptions.h"
 #include "mumlib2_private/audio_packet.h"
 #include "mumlib2_private/varint.h"
@@ -10,27 +14,6 @@ namespace mumlib2 {
     //
     // Ctor
     //
-    AudioPacket AudioPacket::Decode(const uint8_t* buffer, size_t length,size_t pos)
-    {
-        AudioPacket packet;
-        packet.parse_header(buffer, length, pos);
-
-        switch (packet.GetHeaderType()) {
-            case AudioPacketType::CeltAplha:
-            case AudioPacketType::Speex:
-            case AudioPacketType::CeltBeta:
-            case AudioPacketType::Opus:
-                packet.parse_audio(buffer, length, pos+1);
-                break;
-            case AudioPacketType::Ping:
-                packet.parse_ping(buffer, length, pos + 1);
-                break;
-            default:
-                break;
-        }
-        return packet;
-    }
-
     AudioPacket AudioPacket::CreateAudioOpusPacket(uint8_t target, int64_t sequence_number, const uint8_t* payload, size_t payload_len, bool is_last)
     {
         AudioPacket packet;
@@ -55,38 +38,64 @@ namespace mumlib2 {
     //
     // Encode
     //
-    std::vector<uint8_t> AudioPacket::Encode()
+    std::vector<uint8_t> AudioPacket::Encode() const
     {
-        std::vector<uint8_t> result;
-        result.push_back((_header_target & _header_target_mask) | (static_cast<uint8_t>(_header_type) & _header_type_mask));
+        std::vector<uint8_t> result(1 + 2 * VarInt::MaxSize + _audio_payload.size());
+        result.resize(EncodeInto(result));
+        return result;
+    }
 
+    size_t AudioPacket::EncodeInto(std::span<uint8_t> out) const
+    {
         if (GetHeaderType() == AudioPacketType::Ping) {
-            auto timestamp = VarInt(_ping_timestamp).Encode();
-            result.insert(result.end(), timestamp.begin(), timestamp.end());
+            return EncodePingInto(out, _ping_timestamp);
         }
         else if (GetHeaderType() == AudioPacketType::Opus) {
-            //sequence number
-            auto sequence_num = VarInt(_audio_sequencenum).Encode();
-            result.insert(result.end(), sequence_num.begin(), sequence_num.end());
-
-            //opus length
-            uint16_t len = _audio_payload.size();
-            if (GetAudioLastFlag()) {
-                len |= _audio_opus_last_mask;
-            }
-            auto len_encoded = VarInt(len).Encode();
-            result.insert(result.end(), len_encoded.begin(), len_encoded.end());
-
-            //opus payload
-            result.insert(result.end(), _audio_payload.begin(), _audio_payload.end());
-
-            //TODO: position data
+            return EncodeOpusInto(out, _header_target, _audio_sequencenum, _audio_payload, _audio_last);
+        }
+
+        throw AudioPacketException("unsupported type");
+    }
+
+    size_t AudioPacket::EncodeOpusInto(std::span<uint8_t> out, uint8_t target, int64_t sequence_number, std::span<const uint8_t> payload, bool is_last)
+    {
+        if (out.empty()) {
+            throw AudioPacketException("output buffer too small");
+        }
+
+        size_t pos = 0;
+        out[pos++] = (target & _header_target_mask) | (static_cast<uint8_t>(AudioPacketType::Opus) & _header_type_mask);
+
+        //sequence number
+        pos += VarInt(sequence_number).EncodeInto(out.subspan(pos));
+
+        //opus length
+        uint16_t len = static_cast<uint16_t>(payload.size());
+        if (is_last) {
+            len |= _audio_opus_last_mask;
         }
-        else {
-            throw AudioPacketException("unsupported type");
+        pos += VarInt(static_cast<int32_t>(len)).EncodeInto(out.subspan(pos));
+
+        //opus payload
+        if (out.size() - pos < payload.size()) {
+            throw AudioPacketException("output buffer too small");
         }
+        std::copy(payload.begin(), payload.end(), out.begin() + pos);
+        pos += payload.size();
 
-        return result;
+        //TODO: position data
+
+        return pos;
+    }
+
+    size_t AudioPacket::EncodePingInto(std::span<uint8_t> out, int64_t timestamp)
+    {
+        if (out.empty()) {
+            throw AudioPacketException("output buffer too small");
+        }
+
+        out[0] = static_cast<uint8_t>(AudioPacketType::Ping) & _header_type_mask;
+        return 1 + VarInt(timestamp).EncodeInto(out.subspan(1));
     }
 
     //
@@ -131,67 +140,4 @@ namespace mumlib2 {
     {
         return _ping_timestamp;
     }
-
-    //
-    // Parser
-    //
-
-    void AudioPacket::parse_header(const uint8_t* buffer, size_t length, size_t pos)
-    {
-        _header_type = static_cast<AudioPacketType>(buffer[pos] & _header_type_mask);
-        _header_target = buffer[pos] & _header_target_mask;
-    }
-
-    void AudioPacket::parse_audio(const uint8_t* buffer, size_t length, size_t pos)
-    {
-        //session ID
-        VarInt varint_sessionid(&buffer[pos]);
-        _audio_sessionid = varint_sessionid.Value();
-        pos += varint_sessionid.Size();
-
-        //sequence number
-        VarInt varint_sequencenumber(&buffer[pos]);
-        _audio_sequencenum = varint_sequencenumber.Value();
-        pos += varint_sequencenumber.Size();
-
-        //opus
-        if (GetHeaderType() == AudioPacketType::Opus) {
-            //parse header
-            VarInt varint_sequencenumber(&buffer[pos]);
-            int64_t header = varint_sequencenumber.Value();
-            pos += varint_sequencenumber.Size();
-
-            //parse last message bit
-            _audio_last = (header & _audio_opus_last_mask) == _audio_opus_last_mask;
-
-            //copy buffer
-            auto opus_length = header & _audio_opus_length_mask;
-            _audio_payload = std::vector<uint8_t>(buffer + pos, buffer + pos + opus_length);
-
-            //increment pos
-            pos += opus_length;
-        }
-        else {
-            //TODO: support other voice types other than opus
-            return;
-        }
-
-        //parse position data
-        if (pos < length) {
-            for (size_t i = 0; i < _audio_position.size(); i++) {
-                _audio_position[i] = reinterpret_cast<const float*>(buffer + pos)[i];
-            }
-        }
-
-        //check that we are not overrun buffer
-        if (pos != length) {
-            throw AudioPacketException("buffer mismath");
-        }
-    }
-
-    void AudioPacket::parse_ping(const uint8_t* buffer, size_t length, size_t pos) {
-        //timestamp
-        VarInt varint_sessionid(&buffer[pos]);
-        _ping_timestamp = varint_sessionid.Value();
-    }
 }
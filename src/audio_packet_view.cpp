@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <cstring>
+
+//mumlib
+#include "mumlib2/exceptions.h"
+#include "mumlib2_private/audio_packet_view.h"
+#include "mumlib2_private/varint.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+    AudioPacketView AudioPacketView::Decode(std::span<const uint8_t> buffer)
+    {
+        if (buffer.empty()) {
+            throw AudioPacketException("empty packet");
+        }
+
+        AudioPacketView packet;
+        packet.parse_header(buffer, 0);
+
+        switch (packet.GetHeaderType()) {
+            case AudioPacketType::CeltAplha:
+            case AudioPacketType::Speex:
+            case AudioPacketType::CeltBeta:
+            case AudioPacketType::Opus:
+                packet.parse_audio(buffer, 1);
+                break;
+            case AudioPacketType::Ping:
+                packet.parse_ping(buffer, 1);
+                break;
+            default:
+                break;
+        }
+        return packet;
+    }
+
+    //
+    // Getters
+    //
+    uint8_t AudioPacketView::GetHeaderTarget() const
+    {
+        return _header_target;
+    }
+
+    AudioPacketType AudioPacketView::GetHeaderType() const
+    {
+        return _header_type;
+    }
+
+    std::span<const uint8_t> AudioPacketView::GetAudioPayload() const
+    {
+        return _audio_payload;
+    }
+
+    int64_t AudioPacketView::GetAudioSessionId() const
+    {
+        return _audio_sessionid;
+    }
+
+    int64_t AudioPacketView::GetAudioSequenceNumber() const
+    {
+        return _audio_sequencenum;
+    }
+
+    bool AudioPacketView::GetAudioLastFlag() const
+    {
+        return _audio_last;
+    }
+
+    bool AudioPacketView::HasAudioPosition() const
+    {
+        return !_audio_position.empty();
+    }
+
+    std::array<float, 3> AudioPacketView::GetAudioPosition() const
+    {
+        std::array<float, 3> result{};
+        if (HasAudioPosition()) {
+            std::memcpy(result.data(), _audio_position.data(), _audio_position_size);
+        }
+        return result;
+    }
+
+    int64_t AudioPacketView::GetPingTimestamp() const
+    {
+        return _ping_timestamp;
+    }
+
+    //
+    // Parser
+    //
+
+    int64_t AudioPacketView::parse_varint(std::span<const uint8_t> buffer, size_t& pos)
+    {
+        int64_t value = 0;
+
+        auto size = VarInt::Decode(buffer.subspan(std::min(pos, buffer.size())), value);
+        if (!size) {
+            throw AudioPacketException("truncated or malformed varint");
+        }
+
+        pos += size;
+        return value;
+    }
+
+    void AudioPacketView::parse_header(std::span<const uint8_t> buffer, size_t pos)
+    {
+        _header_type = static_cast<AudioPacketType>(buffer[pos] & _header_type_mask);
+        _header_target = buffer[pos] & _header_target_mask;
+    }
+
+    void AudioPacketView::parse_audio(std::span<const uint8_t> buffer, size_t pos)
+    {
+        //session ID
+        _audio_sessionid = parse_varint(buffer, pos);
+
+        //sequence number
+        _audio_sequencenum = parse_varint(buffer, pos);
+
+        //other codecs: hand out the rest of the packet as is
+        if (GetHeaderType() != AudioPacketType::Opus) {
+            _audio_payload = buffer.subspan(pos);
+            return;
+        }
+
+        //opus header
+        int64_t header = parse_varint(buffer, pos);
+        _audio_last = (header & _audio_opus_last_mask) == _audio_opus_last_mask;
+
+        //opus payload
+        size_t opus_length = header & _audio_opus_length_mask;
+        if (pos + opus_length > buffer.size()) {
+            throw AudioPacketException("opus payload exceeds packet length");
+        }
+        _audio_payload = buffer.subspan(pos, opus_length);
+        pos += opus_length;
+
+        //position data
+        size_t remaining = buffer.size() - pos;
+        if (remaining >= _audio_position_size) {
+            _audio_position = buffer.subspan(pos, _audio_position_size);
+        }
+        else if (remaining != 0) {
+            throw AudioPacketException("buffer mismatch");
+        }
+    }
+
+    void AudioPacketView::parse_ping(std::span<const uint8_t> buffer, size_t pos)
+    {
+        //timestamp
+        _ping_timestamp = parse_varint(buffer, pos);
+    }
+}
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <string>
+
+//mumlib
+#include "mumlib2/exceptions.h"
+#include "mumlib2_private/audio_resampler.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace mumlib2 {
+
+    //
+    // Kernels
+    //
+
+    // sum(x[i] * h[i]), `count` is a multiple of 16
+    static int32_t dotProduct(const int16_t* x, const int16_t* h, size_t count)
+    {
+        size_t i = 0;
+        int32_t result = 0;
+
+#if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 16 <= count; i += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        result = _mm_cvtsi128_si32(sum);
+#elif defined(__SSE2__)
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+        result = _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON)
+        int32x4_t acc = vdupq_n_s32(0);
+        for (; i + 8 <= count; i += 8) {
+            int16x8_t a = vld1q_s16(x + i);
+            int16x8_t b = vld1q_s16(h + i);
+            acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+            acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+        }
+        int32x2_t pair = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        result = vget_lane_s32(vpadd_s32(pair, pair), 0);
+#endif
+
+        for (; i < count; i++) {
+            result += static_cast<int32_t>(x[i]) * h[i];
+        }
+        return result;
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    //
+    // Ctor
+    //
+
+    AudioResampler::AudioResampler(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t channels, uint32_t quality)
+        : _input_samplerate(input_samplerate), _output_samplerate(output_samplerate), _channels(channels)
+    {
+        if (!input_samplerate || !output_samplerate || !channels) {
+            throw AudioResamplerException("invalid resampler configuration");
+        }
+
+        auto divisor = std::gcd(input_samplerate, output_samplerate);
+        _up = output_samplerate / divisor;
+        _down = input_samplerate / divisor;
+
+        //keeps the filter bank below 1 MiB, covers all common rates
+        if (_up > 1024) {
+            throw AudioResamplerException("unsupported rate ratio " + std::to_string(input_samplerate) + ":" + std::to_string(output_samplerate));
+        }
+
+        design(std::min(quality, QualityMax));
+
+        _buffers.resize(_channels);
+        Reset();
+    }
+
+    void AudioResampler::design(uint32_t quality)
+    {
+        //taps per phase relative to the lower of both rates, transition band and
+        //stopband attenuation improve with the quality level
+        double ratio = std::max(1.0, static_cast<double>(_down) / _up);
+        size_t taps = static_cast<size_t>(std::ceil((8.0 + 8.0 * quality) * ratio));
+        _taps = (taps + 15) / 16 * 16;
+
+        double rolloff = 0.80 + 0.015 * quality;
+        double beta = 4.0 + 0.6 * quality;
+
+        //prototype at the upsampled rate, cutoff below the lower nyquist frequency
+        size_t length = _taps * _up;
+        double cutoff = 0.5 * rolloff / std::max(_up, _down);
+        double center = (static_cast<double>(length) - 1.0) / 2.0;
+        double norm = besselI0(beta);
+
+        std::vector<double> prototype(length);
+        for (size_t j = 0; j < length; j++) {
+            double t = static_cast<double>(j) - center;
+            double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * std::numbers::pi * cutoff * t) / (2.0 * std::numbers::pi * cutoff * t);
+            double w = t / (center + 1.0);
+            double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - w * w))) / norm;
+
+            //zero stuffing by L is compensated by the gain of L
+            prototype[j] = 2.0 * cutoff * sinc * window * _up;
+        }
+
+        //phase p, window index k applies to input x[pos - (taps - 1) + k]
+        _coefficients.resize(_up * _taps);
+        for (uint32_t p = 0; p < _up; p++) {
+            for (size_t k = 0; k < _taps; k++) {
+                double value = prototype[p + (_taps - 1 - k) * _up] * (1 << 14);
+                _coefficients[p * _taps + k] = static_cast<int16_t>(std::clamp(std::lround(value), -32768l, 32767l));
+            }
+        }
+    }
+
+    void AudioResampler::Reset()
+    {
+        for (auto& buffer : _buffers) {
+            buffer.assign(_taps - 1, 0);
+        }
+        _position = _taps - 1;
+        _phase = 0;
+    }
+
+    //
+    // Processing
+    //
+
+    size_t AudioResampler::MaxOutput(size_t in_samples) const
+    {
+        return (in_samples + 1) * _up / _down + 2;
+    }
+
+    size_t AudioResampler::Process(const int16_t* in, size_t in_samples, int16_t* out)
+    {
+        if (!in_samples) {
+            return 0;
+        }
+
+        size_t history = _taps - 1;
+        size_t produced = 0;
+
+        for (uint32_t channel = 0; channel < _channels; channel++) {
+            auto& buffer = _buffers[channel];
+
+            //append the new input behind the history
+            buffer.resize(history + in_samples);
+            for (size_t i = 0; i < in_samples; i++) {
+                buffer[history + i] = in[i * _channels + channel];
+            }
+
+            size_t position = _position;
+            uint32_t phase = _phase;
+            size_t count = 0;
+
+            while (position < buffer.size()) {
+                auto sum = dotProduct(buffer.data() + position - history, _coefficients.data() + phase * _taps, _taps);
+                out[count * _channels + channel] = static_cast<int16_t>(std::clamp((sum + (1 << 13)) >> 14, -32768, 32767));
+                count++;
+
+                phase += _down;
+                position += phase / _up;
+                phase %= _up;
+            }
+
+            //keep the tail for the next call
+            std::copy(buffer.end() - static_cast<std::ptrdiff_t>(history), buffer.end(), buffer.begin());
+            buffer.resize(history);
+
+            if (channel + 1 == _channels) {
+                _position = position - in_samples;
+                _phase = phase;
+            }
+            produced = count;
+        }
+
+        return produced;
+    }
+
+    //
+    // Getters
+    //
+
+    uint32_t AudioResampler::GetInputSamplerate() const
+    {
+        return _input_samplerate;
+    }
+
+    uint32_t AudioResampler::GetOutputSamplerate() const
+    {
+        return _output_samplerate;
+    }
+}
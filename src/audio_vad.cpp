@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <cmath>
+
+//mumlib
+#include "mumlib2_private/audio_vad.h"
+
+namespace mumlib2 {
+
+    void AudioVad::SetConfig(const AudioVadConfig& config)
+    {
+        _config = config;
+
+        if (!_config.enabled) {
+            _hangover_left_ms = 0;
+            _stats.talking = false;
+        }
+    }
+
+    bool AudioVad::IsEnabled() const
+    {
+        return _config.enabled;
+    }
+
+    bool AudioVad::Process(const int16_t* pcm, size_t count, uint32_t duration_ms)
+    {
+        if (!count) {
+            return _stats.talking;
+        }
+
+        //energy and zero crossings
+        int64_t energy = 0;
+        size_t crossings = 0;
+        for (size_t i = 0; i < count; i++) {
+            energy += static_cast<int64_t>(pcm[i]) * pcm[i];
+            if (i && ((pcm[i] ^ pcm[i - 1]) < 0)) {
+                crossings++;
+            }
+        }
+
+        //digital silence ends up far below any threshold
+        double mean = static_cast<double>(energy) / static_cast<double>(count);
+        float level_db = static_cast<float>(10.0 * std::log10(mean / (32768.0 * 32768.0) + 1e-12));
+        float zcr = static_cast<float>(crossings) / static_cast<float>(count);
+
+        float margin = _config.margin_db;
+        if (zcr > _noise_zcr) {
+            margin *= 2.0f;
+        }
+
+        bool voiced = level_db > _config.threshold_db && level_db > _noise_floor_db + margin;
+
+        //track the noise floor outside of speech
+        if (level_db < _noise_floor_db) {
+            _noise_floor_db = level_db;
+        }
+        else if (!voiced) {
+            _noise_floor_db = std::min(level_db, _noise_floor_db + _noise_rise_db_per_s * static_cast<float>(duration_ms) / 1000.0f);
+        }
+
+        bool talking = voiced || _hangover_left_ms > 0;
+        if (voiced) {
+            _hangover_left_ms = _config.hangover_ms;
+        }
+        else {
+            _hangover_left_ms -= std::min(_hangover_left_ms, duration_ms);
+        }
+
+        if (talking && !_stats.talking) {
+            _stats.talk_spurts++;
+        }
+        _stats.talking = talking;
+
+        if (talking) {
+            _stats.frames_talk++;
+        }
+        else {
+            _stats.frames_silent++;
+        }
+
+        return talking;
+    }
+
+    AudioVadStats AudioVad::GetStats() const
+    {
+        auto stats = _stats;
+        stats.noise_floor_db = _noise_floor_db;
+        return stats;
+    }
+}
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+
+//mumlib
+#include "mumlib2_private/channel_tree.h"
+
+namespace mumlib2 {
+
+    //
+    // Lookup
+    //
+
+    const MumbleChannel* ChannelTree::Get(int32_t channel_id) const
+    {
+        auto it = _channels.find(channel_id);
+        return it != _channels.end() ? it->second.get() : nullptr;
+    }
+
+    bool ChannelTree::Contains(int32_t channel_id) const
+    {
+        return _channels.contains(channel_id);
+    }
+
+    size_t ChannelTree::Size() const
+    {
+        return _channels.size();
+    }
+
+    int32_t ChannelTree::Find(const std::string& name) const
+    {
+        auto it = _names.find(name);
+        return it != _names.end() ? it->second.front() : -1;
+    }
+
+    int32_t ChannelTree::FindPath(std::string_view path) const
+    {
+        auto* root = Get(_root_id);
+        if (!root) {
+            return -1;
+        }
+
+        int32_t current = _root_id;
+        bool first = true;
+        while (!path.empty()) {
+            auto separator = path.find('/');
+            auto component = path.substr(0, separator);
+            path = separator == std::string_view::npos ? std::string_view() : path.substr(separator + 1);
+
+            if (component.empty() || (first && component == root->name)) {
+                first = false;
+                continue;
+            }
+            first = false;
+
+            int32_t next = -1;
+            for (auto child : GetChildren(current)) {
+                if (_channels.at(child)->name == component) {
+                    next = child;
+                    break;
+                }
+            }
+
+            if (next < 0) {
+                return -1;
+            }
+            current = next;
+        }
+
+        return current;
+    }
+
+    std::span<const int32_t> ChannelTree::GetChildren(int32_t channel_id) const
+    {
+        auto it = _children.find(channel_id);
+        if (it == _children.end()) {
+            return {};
+        }
+        return it->second;
+    }
+
+    std::vector<MumbleChannel> ChannelTree::GetList() const
+    {
+        std::vector<MumbleChannel> result;
+        result.reserve(_channels.size());
+        for (const auto& channel : _channels) {
+            result.push_back(*channel.second);
+        }
+
+        std::sort(result.begin(), result.end(), [](const MumbleChannel& a, const MumbleChannel& b) { return a.channelId < b.channelId; });
+        return result;
+    }
+
+    //
+    // Modification
+    //
+
+    void ChannelTree::Update(const ChannelTreeUpdate& update)
+    {
+        auto channel_id = update.channel_id;
+        if (channel_id < 0) {
+            return;
+        }
+
+        if (!Contains(channel_id)) {
+            auto channel = std::make_shared<MumbleChannel>();
+            channel->channelId = channel_id;
+            _channels.emplace(channel_id, std::move(channel));
+            nameAdd("", channel_id);
+        }
+
+        auto& channel = mutate(channel_id);
+
+        if (update.name && *update.name != channel.name) {
+            nameRemove(channel.name, channel_id);
+            channel.name = *update.name;
+            nameAdd(channel.name, channel_id);
+        }
+
+        if (update.parent && *update.parent != channel.parent) {
+            childRemove(channel.parent, channel_id);
+            channel.parent = *update.parent;
+            childAdd(channel.parent, channel_id);
+        }
+
+        if (update.description) {
+            channel.description = *update.description;
+        }
+
+        if (update.temporary) {
+            channel.temporary = *update.temporary;
+        }
+
+        if (update.position) {
+            channel.position = *update.position;
+        }
+
+        //links are symmetric, the linked channel is updated as well
+        if (update.links) {
+            auto previous = channel.links;
+            for (auto other : previous) {
+                linkSet(channel_id, other, false);
+            }
+            for (auto other : *update.links) {
+                linkSet(channel_id, other, true);
+            }
+        }
+
+        for (auto other : update.links_add) {
+            linkSet(channel_id, other, true);
+        }
+
+        for (auto other : update.links_remove) {
+            linkSet(channel_id, other, false);
+        }
+    }
+
+    bool ChannelTree::Erase(int32_t channel_id)
+    {
+        auto it = _channels.find(channel_id);
+        if (it == _channels.end()) {
+            return false;
+        }
+
+        auto links = it->second->links;
+        for (auto other : links) {
+            linkSet(channel_id, other, false);
+        }
+
+        childRemove(it->second->parent, channel_id);
+        nameRemove(it->second->name, channel_id);
+
+        _channels.erase(channel_id);
+        _children.erase(channel_id);
+        return true;
+    }
+
+    void ChannelTree::Clear()
+    {
+        _channels.clear();
+        _children.clear();
+        _names.clear();
+    }
+
+    MumbleChannel& ChannelTree::mutate(int32_t channel_id)
+    {
+        //clone entries shared with a copy of the tree
+        auto& channel = _channels.at(channel_id);
+        if (channel.use_count() > 1) {
+            channel = std::make_shared<MumbleChannel>(*channel);
+        }
+        return *channel;
+    }
+
+    void ChannelTree::childAdd(int32_t parent, int32_t channel_id)
+    {
+        if (parent >= 0) {
+            _children[parent].push_back(channel_id);
+        }
+    }
+
+    void ChannelTree::childRemove(int32_t parent, int32_t channel_id)
+    {
+        auto it = _children.find(parent);
+        if (it == _children.end()) {
+            return;
+        }
+
+        std::erase(it->second, channel_id);
+        if (it->second.empty()) {
+            _children.erase(it);
+        }
+    }
+
+    void ChannelTree::nameAdd(const std::string& name, int32_t channel_id)
+    {
+        _names[name].push_back(channel_id);
+    }
+
+    void ChannelTree::nameRemove(const std::string& name, int32_t channel_id)
+    {
+        auto it = _names.find(name);
+        if (it == _names.end()) {
+            return;
+        }
+
+        std::erase(it->second, channel_id);
+        if (it->second.empty()) {
+            _names.erase(it);
+        }
+    }
+
+    void ChannelTree::linkSet(int32_t channel_id, int32_t other_id, bool state)
+    {
+        for (auto [from, to] : { std::pair(channel_id, other_id), std::pair(other_id, channel_id) }) {
+            if (!Contains(from)) {
+                continue;
+            }
+
+            auto& links = _channels.at(from)->links;
+            auto it = std::lower_bound(links.begin(), links.end(), static_cast<uint32_t>(to));
+            bool linked = it != links.end() && *it == static_cast<uint32_t>(to);
+            if (linked == state) {
+                continue;
+            }
+
+            auto& channel = mutate(from);
+            it = std::lower_bound(channel.links.begin(), channel.links.end(), static_cast<uint32_t>(to));
+            if (state) {
+                channel.links.insert(it, static_cast<uint32_t>(to));
+            }
+            else {
+                channel.links.erase(it);
+            }
+        }
+    }
+}
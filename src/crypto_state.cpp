@@ -3,6 +3,7 @@
 // Copyright (c) 2015-2022 mumlib2 contributors
 
 //stdlib
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
@@ -39,16 +40,39 @@ namespace mumlib2 {
 		uiRemoteGood = uiRemoteLate = uiRemoteLost = uiRemoteResync = 0;
 	}
 
+	CryptState::~CryptState() {
+		freeCiphers();
+	}
+
 	bool CryptState::isValid() const {
 		return bInit;
 	}
 
+	unsigned int CryptState::getGood() const {
+		return uiGood;
+	}
+
+	unsigned int CryptState::getLate() const {
+		return uiLate;
+	}
+
+	unsigned int CryptState::getLost() const {
+		return uiLost;
+	}
+
+	unsigned int CryptState::getResync() const {
+		return uiResync;
+	}
+
+	bool CryptState::isAccelerated() const {
+		return evp_encrypt && evp_decrypt_forward && evp_decrypt;
+	}
+
 	void CryptState::genKey() {
 		RAND_bytes(raw_key, AES_BLOCK_SIZE);
 		RAND_bytes(encrypt_iv, AES_BLOCK_SIZE);
 		RAND_bytes(decrypt_iv, AES_BLOCK_SIZE);
-		AES_set_encrypt_key(raw_key, 128, &encrypt_key);
-		AES_set_decrypt_key(raw_key, 128, &decrypt_key);
+		initCiphers();
 		bInit = true;
 	}
 
@@ -56,9 +80,78 @@ namespace mumlib2 {
 		memcpy(raw_key, rkey, AES_BLOCK_SIZE);
 		memcpy(encrypt_iv, eiv, AES_BLOCK_SIZE);
 		memcpy(decrypt_iv, div, AES_BLOCK_SIZE);
+		initCiphers();
+		bInit = true;
+	}
+
+	void CryptState::initCiphers() {
 		AES_set_encrypt_key(raw_key, 128, &encrypt_key);
 		AES_set_decrypt_key(raw_key, 128, &decrypt_key);
-		bInit = true;
+
+		freeCiphers();
+
+#if defined(MUMLIB2_CRYPTO_EVP)
+		evp_encrypt = EVP_CIPHER_CTX_new();
+		evp_decrypt_forward = EVP_CIPHER_CTX_new();
+		evp_decrypt = EVP_CIPHER_CTX_new();
+
+		bool ok = evp_encrypt && evp_decrypt_forward && evp_decrypt
+			&& EVP_EncryptInit_ex(evp_encrypt, EVP_aes_128_ecb(), nullptr, raw_key, nullptr) == 1
+			&& EVP_CIPHER_CTX_set_padding(evp_encrypt, 0) == 1
+			&& EVP_EncryptInit_ex(evp_decrypt_forward, EVP_aes_128_ecb(), nullptr, raw_key, nullptr) == 1
+			&& EVP_CIPHER_CTX_set_padding(evp_decrypt_forward, 0) == 1
+			&& EVP_DecryptInit_ex(evp_decrypt, EVP_aes_128_ecb(), nullptr, raw_key, nullptr) == 1
+			&& EVP_CIPHER_CTX_set_padding(evp_decrypt, 0) == 1;
+
+		//fall back to the portable implementation
+		if (!ok) {
+			freeCiphers();
+		}
+#endif
+	}
+
+	void CryptState::freeCiphers() {
+		if (evp_encrypt) {
+			EVP_CIPHER_CTX_free(evp_encrypt);
+			evp_encrypt = nullptr;
+		}
+		if (evp_decrypt_forward) {
+			EVP_CIPHER_CTX_free(evp_decrypt_forward);
+			evp_decrypt_forward = nullptr;
+		}
+		if (evp_decrypt) {
+			EVP_CIPHER_CTX_free(evp_decrypt);
+			evp_decrypt = nullptr;
+		}
+	}
+
+	void CryptState::aesEncryptBlocks(EVP_CIPHER_CTX* ctx, const unsigned char* in, unsigned char* out, size_t blocks) {
+		//on failure the portable implementation produces the output
+		if (ctx) {
+			int outl = 0;
+			int len = static_cast<int>(blocks * AES_BLOCK_SIZE);
+			if (EVP_EncryptUpdate(ctx, out, &outl, in, len) == 1 && outl == len) {
+				return;
+			}
+		}
+
+		for (size_t i = 0; i < blocks; i++) {
+			AES_encrypt(in + i * AES_BLOCK_SIZE, out + i * AES_BLOCK_SIZE, &encrypt_key);
+		}
+	}
+
+	void CryptState::aesDecryptBlocks(const unsigned char* in, unsigned char* out, size_t blocks) {
+		if (evp_decrypt) {
+			int outl = 0;
+			int len = static_cast<int>(blocks * AES_BLOCK_SIZE);
+			if (EVP_DecryptUpdate(evp_decrypt, out, &outl, in, len) == 1 && outl == len) {
+				return;
+			}
+		}
+
+		for (size_t i = 0; i < blocks; i++) {
+			AES_decrypt(in + i * AES_BLOCK_SIZE, out + i * AES_BLOCK_SIZE, &decrypt_key);
+		}
 	}
 
 	void CryptState::setDecryptIV(const unsigned char* iv) {
@@ -85,21 +178,12 @@ namespace mumlib2 {
 		dst[3] = tag[2];
 	}
 
-	bool CryptState::decrypt(const unsigned char* source, unsigned char* dst, unsigned int crypted_length) {
-		if (crypted_length < 4)
-			return false;
+	bool CryptState::decryptBegin(unsigned char ivbyte, DecryptStep& step) {
+		step.restore = false;
+		step.late = 0;
+		step.lost = 0;
 
-		unsigned int plain_length = crypted_length - 4;
-
-		unsigned char saveiv[AES_BLOCK_SIZE];
-		unsigned char ivbyte = source[0];
-		bool restore = false;
-		unsigned char tag[AES_BLOCK_SIZE];
-
-		int lost = 0;
-		int late = 0;
-
-		memcpy(saveiv, decrypt_iv, AES_BLOCK_SIZE);
+		memcpy(step.saveiv, decrypt_iv, AES_BLOCK_SIZE);
 
 		if (((decrypt_iv[0] + 1) & 0xFF) == ivbyte) {
 			// In order as expected.
@@ -127,29 +211,29 @@ namespace mumlib2 {
 
 			if ((ivbyte < decrypt_iv[0]) && (diff > -30) && (diff < 0)) {
 				// Late packet, but no wraparound.
-				late = 1;
-				lost = -1;
+				step.late = 1;
+				step.lost = -1;
 				decrypt_iv[0] = ivbyte;
-				restore = true;
+				step.restore = true;
 			}
 			else if ((ivbyte > decrypt_iv[0]) && (diff > -30) && (diff < 0)) {
 				// Last was 0x02, here comes 0xff from last round
-				late = 1;
-				lost = -1;
+				step.late = 1;
+				step.lost = -1;
 				decrypt_iv[0] = ivbyte;
 				for (int i = 1; i < AES_BLOCK_SIZE; i++)
 					if (decrypt_iv[i]--)
 						break;
-				restore = true;
+				step.restore = true;
 			}
 			else if ((ivbyte > decrypt_iv[0]) && (diff > 0)) {
 				// Lost a few packets, but beyond that we're good.
-				lost = ivbyte - decrypt_iv[0] - 1;
+				step.lost = ivbyte - decrypt_iv[0] - 1;
 				decrypt_iv[0] = ivbyte;
 			}
 			else if ((ivbyte < decrypt_iv[0]) && (diff > 0)) {
 				// Lost a few packets, and wrapped around
-				lost = 256 - decrypt_iv[0] + ivbyte - 1;
+				step.lost = 256 - decrypt_iv[0] + ivbyte - 1;
 				decrypt_iv[0] = ivbyte;
 				for (int i = 1; i < AES_BLOCK_SIZE; i++)
 					if (++decrypt_iv[i])
@@ -160,27 +244,115 @@ namespace mumlib2 {
 			}
 
 			if (decrypt_history[decrypt_iv[0]] == decrypt_iv[1]) {
-				memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
+				memcpy(decrypt_iv, step.saveiv, AES_BLOCK_SIZE);
 				return false;
 			}
 		}
 
+		memcpy(step.nonce, decrypt_iv, AES_BLOCK_SIZE);
+		return true;
+	}
+
+	void CryptState::decryptCommit(DecryptStep& step) {
+		step.history_old = decrypt_history[step.nonce[0]];
+		decrypt_history[step.nonce[0]] = step.nonce[1];
+
+		if (step.restore)
+			memcpy(decrypt_iv, step.saveiv, AES_BLOCK_SIZE);
+
+		uiGood++;
+		uiLate += step.late;
+		uiLost += step.lost;
+	}
+
+	void CryptState::decryptUndo(const DecryptStep& step) {
+		decrypt_history[step.nonce[0]] = step.history_old;
+
+		uiGood--;
+		uiLate -= step.late;
+		uiLost -= step.lost;
+	}
+
+	bool CryptState::decrypt(const unsigned char* source, unsigned char* dst, unsigned int crypted_length) {
+		if (crypted_length < 4)
+			return false;
+
+		unsigned int plain_length = crypted_length - 4;
+		unsigned char tag[AES_BLOCK_SIZE];
+
+		DecryptStep step;
+		if (!decryptBegin(source[0], step))
+			return false;
+
 		ocb_decrypt(source + 4, dst, plain_length, decrypt_iv, tag);
 
 		if (memcmp(tag, source + 1, 3) != 0) {
-			memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
+			memcpy(decrypt_iv, step.saveiv, AES_BLOCK_SIZE);
 			return false;
 		}
-		decrypt_history[decrypt_iv[0]] = decrypt_iv[1];
 
-		if (restore)
-			memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
+		decryptCommit(step);
+		return true;
+	}
 
-		uiGood++;
-		uiLate += late;
-		uiLost += lost;
+	size_t CryptState::decryptBatch(CryptBatchItem* items, size_t count) {
+		size_t good = 0;
 
-		return true;
+		while (count) {
+			size_t n = std::min(count, DecryptBatchMax);
+
+			DecryptStep steps[DecryptBatchMax];
+			OcbJob jobs[DecryptBatchMax];
+			size_t job_item[DecryptBatchMax];
+			size_t jobs_count = 0;
+
+			// Speculatively advance the IV/history as if every tag was valid
+			for (size_t i = 0; i < n; i++) {
+				auto& item = items[i];
+				item.ok = false;
+
+				if (item.crypted_length < 4 || !decryptBegin(item.source[0], steps[jobs_count]))
+					continue;
+
+				auto& job = jobs[jobs_count];
+				job.encrypted = item.source + 4;
+				job.plain = item.dst;
+				job.len = item.crypted_length - 4;
+				job.nonce = steps[jobs_count].nonce;
+
+				decryptCommit(steps[jobs_count]);
+				job_item[jobs_count++] = i;
+			}
+
+			ocb_decrypt_batch(jobs, jobs_count);
+
+			for (size_t j = 0; j < jobs_count; j++) {
+				auto& item = items[job_item[j]];
+
+				if (memcmp(jobs[j].tag, item.source + 1, 3) == 0) {
+					item.ok = true;
+					good++;
+					continue;
+				}
+
+				// Forged or corrupted packet: unwind everything from here on and
+				// let the serial path handle the rest of this batch
+				for (size_t k = jobs_count; k-- > j;)
+					decryptUndo(steps[k]);
+				memcpy(decrypt_iv, steps[j].saveiv, AES_BLOCK_SIZE);
+
+				for (size_t i = job_item[j] + 1; i < n; i++) {
+					items[i].ok = decrypt(items[i].source, items[i].dst, items[i].crypted_length);
+					good += items[i].ok;
+				}
+				break;
+			}
+
+			items += n;
+			count -= n;
+		}
+
+		return good;
 	}
 
 	static void inline XOR(subblock* dst, const subblock* a, const subblock* b) {
@@ -208,33 +380,56 @@ namespace mumlib2 {
 			block[i] = 0;
 	}
 
-#define AESencrypt(src, dst, key) AES_encrypt(reinterpret_cast<const unsigned char *>(src),reinterpret_cast<unsigned char *>(dst), key);
-#define AESdecrypt(src, dst, key) AES_decrypt(reinterpret_cast<const unsigned char *>(src),reinterpret_cast<unsigned char *>(dst), key);
+	// Number of full blocks handed to the block cipher at once. The OCB offsets
+	// only depend on the nonce, so they are computed for the whole batch up front
+	// and the AES rounds of independent blocks can be pipelined by EVP/AES-NI.
+	static constexpr unsigned int OCB_BATCH_BLOCKS = 32;
+
+	static void inline LOAD(subblock* dst, const unsigned char* src) {
+		memcpy(dst, src, AES_BLOCK_SIZE);
+	}
+
+	static void inline STORE(unsigned char* dst, const subblock* src) {
+		memcpy(dst, src, AES_BLOCK_SIZE);
+	}
 
 	void CryptState::ocb_encrypt(const unsigned char* plain, unsigned char* encrypted, unsigned int len,
 		const unsigned char* nonce, unsigned char* tag) {
 		keyblock checksum, delta, tmp, pad;
+		keyblock deltas[OCB_BATCH_BLOCKS], blocks[OCB_BATCH_BLOCKS];
 
 		// Initialize
-		AESencrypt(nonce, delta, &encrypt_key);
+		aesEncryptBlocks(evp_encrypt, nonce, reinterpret_cast<unsigned char*>(delta), 1);
 		ZERO(checksum);
 
 		while (len > AES_BLOCK_SIZE) {
-			S2(delta);
-			XOR(tmp, delta, reinterpret_cast<const subblock*>(plain));
-			AESencrypt(tmp, tmp, &encrypt_key);
-			XOR(reinterpret_cast<subblock*>(encrypted), delta, tmp);
-			XOR(checksum, checksum, reinterpret_cast<const subblock*>(plain));
-			len -= AES_BLOCK_SIZE;
-			plain += AES_BLOCK_SIZE;
-			encrypted += AES_BLOCK_SIZE;
+			unsigned int count = std::min((len - 1) / AES_BLOCK_SIZE, OCB_BATCH_BLOCKS);
+
+			for (unsigned int i = 0; i < count; i++) {
+				S2(delta);
+				memcpy(deltas[i], delta, AES_BLOCK_SIZE);
+				LOAD(tmp, plain + i * AES_BLOCK_SIZE);
+				XOR(checksum, checksum, tmp);
+				XOR(blocks[i], delta, tmp);
+			}
+
+			aesEncryptBlocks(evp_encrypt, reinterpret_cast<unsigned char*>(blocks), reinterpret_cast<unsigned char*>(blocks), count);
+
+			for (unsigned int i = 0; i < count; i++) {
+				XOR(tmp, deltas[i], blocks[i]);
+				STORE(encrypted + i * AES_BLOCK_SIZE, tmp);
+			}
+
+			len -= count * AES_BLOCK_SIZE;
+			plain += count * AES_BLOCK_SIZE;
+			encrypted += count * AES_BLOCK_SIZE;
 		}
 
 		S2(delta);
 		ZERO(tmp);
-		tmp[BLOCKSIZE - 1] = SWAPPED(len * 8);
+		tmp[BLOCKSIZE - 1] = SWAPPED(static_cast<subblock>(len) * 8);
 		XOR(tmp, tmp, delta);
-		AESencrypt(tmp, pad, &encrypt_key);
+		aesEncryptBlocks(evp_encrypt, reinterpret_cast<unsigned char*>(tmp), reinterpret_cast<unsigned char*>(pad), 1);
 		memcpy(tmp, plain, len);
 		memcpy(reinterpret_cast<unsigned char*>(tmp) + len, reinterpret_cast<const unsigned char*>(pad) + len,
 			AES_BLOCK_SIZE - len);
@@ -244,33 +439,125 @@ namespace mumlib2 {
 
 		S3(delta);
 		XOR(tmp, delta, checksum);
-		AESencrypt(tmp, tag, &encrypt_key);
+		aesEncryptBlocks(evp_encrypt, reinterpret_cast<unsigned char*>(tmp), tag, 1);
+	}
+
+	void CryptState::ocb_decrypt_batch(OcbJob* jobs, size_t count) {
+		keyblock delta[DecryptBatchMax], checksum[DecryptBatchMax], tmp[DecryptBatchMax], pad[DecryptBatchMax];
+		unsigned int full[DecryptBatchMax];
+
+		if (!count)
+			return;
+
+		// Offsets of all packets in one go
+		size_t total = 0;
+		for (size_t j = 0; j < count; j++) {
+			memcpy(tmp[j], jobs[j].nonce, AES_BLOCK_SIZE);
+			full[j] = jobs[j].len > AES_BLOCK_SIZE ? (jobs[j].len - 1) / AES_BLOCK_SIZE : 0;
+			total += full[j];
+			ZERO(checksum[j]);
+		}
+		aesEncryptBlocks(evp_decrypt_forward, reinterpret_cast<unsigned char*>(tmp), reinterpret_cast<unsigned char*>(delta), count);
+
+		// Full blocks of all packets interleaved into a single cipher call
+		if (total) {
+			if (batch_scratch.size() < total * 2 * BLOCKSIZE)
+				batch_scratch.resize(total * 2 * BLOCKSIZE);
+
+			auto* blocks = reinterpret_cast<keyblock*>(batch_scratch.data());
+			auto* offsets = blocks + total;
+
+			size_t b = 0;
+			for (size_t j = 0; j < count; j++) {
+				for (unsigned int i = 0; i < full[j]; i++, b++) {
+					keyblock in;
+					S2(delta[j]);
+					memcpy(offsets[b], delta[j], AES_BLOCK_SIZE);
+					LOAD(in, jobs[j].encrypted + i * AES_BLOCK_SIZE);
+					XOR(blocks[b], delta[j], in);
+				}
+			}
+
+			aesDecryptBlocks(reinterpret_cast<unsigned char*>(blocks), reinterpret_cast<unsigned char*>(blocks), total);
+
+			b = 0;
+			for (size_t j = 0; j < count; j++) {
+				for (unsigned int i = 0; i < full[j]; i++, b++) {
+					keyblock out;
+					XOR(out, offsets[b], blocks[b]);
+					XOR(checksum[j], checksum[j], out);
+					STORE(jobs[j].plain + i * AES_BLOCK_SIZE, out);
+				}
+			}
+		}
+
+		// Final partial blocks
+		for (size_t j = 0; j < count; j++) {
+			unsigned int len = jobs[j].len - full[j] * AES_BLOCK_SIZE;
+			S2(delta[j]);
+			ZERO(tmp[j]);
+			tmp[j][BLOCKSIZE - 1] = SWAPPED(static_cast<subblock>(len) * 8);
+			XOR(tmp[j], tmp[j], delta[j]);
+		}
+		aesEncryptBlocks(evp_decrypt_forward, reinterpret_cast<unsigned char*>(tmp), reinterpret_cast<unsigned char*>(pad), count);
+
+		for (size_t j = 0; j < count; j++) {
+			unsigned int offset = full[j] * AES_BLOCK_SIZE;
+			unsigned int len = jobs[j].len - offset;
+			keyblock last;
+			ZERO(last);
+			memcpy(last, jobs[j].encrypted + offset, len);
+			XOR(last, last, pad[j]);
+			XOR(checksum[j], checksum[j], last);
+			memcpy(jobs[j].plain + offset, last, len);
+
+			S3(delta[j]);
+			XOR(tmp[j], delta[j], checksum[j]);
+		}
+
+		// Tags
+		aesEncryptBlocks(evp_decrypt_forward, reinterpret_cast<unsigned char*>(tmp), reinterpret_cast<unsigned char*>(pad), count);
+		for (size_t j = 0; j < count; j++)
+			memcpy(jobs[j].tag, pad[j], AES_BLOCK_SIZE);
 	}
 
 	void CryptState::ocb_decrypt(const unsigned char* encrypted, unsigned char* plain, unsigned int len,
 		const unsigned char* nonce, unsigned char* tag) {
 		keyblock checksum, delta, tmp, pad;
+		keyblock deltas[OCB_BATCH_BLOCKS], blocks[OCB_BATCH_BLOCKS];
 
 		// Initialize
-		AESencrypt(nonce, delta, &encrypt_key);
+		aesEncryptBlocks(evp_decrypt_forward, nonce, reinterpret_cast<unsigned char*>(delta), 1);
 		ZERO(checksum);
 
 		while (len > AES_BLOCK_SIZE) {
-			S2(delta);
-			XOR(tmp, delta, reinterpret_cast<const subblock*>(encrypted));
-			AESdecrypt(tmp, tmp, &decrypt_key);
-			XOR(reinterpret_cast<subblock*>(plain), delta, tmp);
-			XOR(checksum, checksum, reinterpret_cast<const subblock*>(plain));
-			len -= AES_BLOCK_SIZE;
-			plain += AES_BLOCK_SIZE;
-			encrypted += AES_BLOCK_SIZE;
+			unsigned int count = std::min((len - 1) / AES_BLOCK_SIZE, OCB_BATCH_BLOCKS);
+
+			for (unsigned int i = 0; i < count; i++) {
+				S2(delta);
+				memcpy(deltas[i], delta, AES_BLOCK_SIZE);
+				LOAD(tmp, encrypted + i * AES_BLOCK_SIZE);
+				XOR(blocks[i], delta, tmp);
+			}
+
+			aesDecryptBlocks(reinterpret_cast<unsigned char*>(blocks), reinterpret_cast<unsigned char*>(blocks), count);
+
+			for (unsigned int i = 0; i < count; i++) {
+				XOR(tmp, deltas[i], blocks[i]);
+				XOR(checksum, checksum, tmp);
+				STORE(plain + i * AES_BLOCK_SIZE, tmp);
+			}
+
+			len -= count * AES_BLOCK_SIZE;
+			plain += count * AES_BLOCK_SIZE;
+			encrypted += count * AES_BLOCK_SIZE;
 		}
 
 		S2(delta);
 		ZERO(tmp);
-		tmp[BLOCKSIZE - 1] = SWAPPED(len * 8);
+		tmp[BLOCKSIZE - 1] = SWAPPED(static_cast<subblock>(len) * 8);
 		XOR(tmp, tmp, delta);
-		AESencrypt(tmp, pad, &encrypt_key);
+		aesEncryptBlocks(evp_decrypt_forward, reinterpret_cast<unsigned char*>(tmp), reinterpret_cast<unsigned char*>(pad), 1);
 		memset(tmp, 0, AES_BLOCK_SIZE);
 		memcpy(tmp, encrypted, len);
 		XOR(tmp, tmp, pad);
@@ -279,6 +566,6 @@ namespace mumlib2 {
 
 		S3(delta);
 		XOR(tmp, delta, checksum);
-		AESencrypt(tmp, tag, &encrypt_key);
+		aesEncryptBlocks(evp_decrypt_forward, reinterpret_cast<unsigned char*>(tmp), tag, 1);
 	}
-}
\ No newline at end of file
+}
@@ -11,6 +11,10 @@ namespace mumlib2 {
         impl = std::make_unique<Mumlib2Private>(callback);
     }
 
+    Mumlib2::Mumlib2(Callback& callback, Mumlib2Host& host) {
+        impl = std::make_unique<Mumlib2Private>(callback, host.impl.get());
+    }
+
     Mumlib2::~Mumlib2() {
         disconnect();
     }
@@ -26,7 +30,96 @@ namespace mumlib2 {
     //
     // Audio
     //
-    
+    void Mumlib2::AudioFlush(uint32_t target)
+    {
+        impl->AudioFlush(target);
+    }
+
+    bool Mumlib2::AudioSetInputConfig(const AudioInputConfig& config)
+    {
+        return impl->AudioSetInputConfig(config);
+    }
+
+    AudioInputStats Mumlib2::AudioGetInputStats()
+    {
+        return impl->AudioGetInputStats();
+    }
+
+    void Mumlib2::AudioSetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet)
+    {
+        impl->AudioSetFrameSize(frame_ms, frames_per_packet);
+    }
+
+    void Mumlib2::AudioSetEncoderProfile(const AudioEncoderProfile& profile)
+    {
+        impl->AudioSetEncoderProfile(profile);
+    }
+
+    AudioEncoderProfile Mumlib2::AudioGetEncoderProfile()
+    {
+        return impl->AudioGetEncoderProfile();
+    }
+
+    void Mumlib2::AudioSetSamplerate(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t quality)
+    {
+        impl->AudioSetSamplerate(input_samplerate, output_samplerate, quality);
+    }
+
+    void Mumlib2::AudioSetFec(bool enabled)
+    {
+        impl->AudioSetFec(enabled);
+    }
+
+    void Mumlib2::AudioSetVadConfig(const AudioVadConfig& config)
+    {
+        impl->AudioSetVadConfig(config);
+    }
+
+    AudioVadStats Mumlib2::AudioGetVadStats()
+    {
+        return impl->AudioGetVadStats();
+    }
+
+    void Mumlib2::AudioSetDecoderThreads(uint32_t threads)
+    {
+        impl->AudioSetDecoderThreads(threads);
+    }
+
+    void Mumlib2::AudioSetJitterConfig(const JitterBufferConfig& config)
+    {
+        impl->AudioSetJitterConfig(config);
+    }
+
+    std::vector<JitterBufferStats> Mumlib2::AudioGetJitterStats()
+    {
+        return impl->AudioGetJitterStats();
+    }
+
+    void Mumlib2::AudioSetMixerConfig(const AudioMixerConfig& config)
+    {
+        impl->AudioSetMixerConfig(config);
+    }
+
+    void Mumlib2::AudioSetSpeakerGain(int32_t session_id, float gain)
+    {
+        impl->AudioSetSpeakerGain(session_id, gain);
+    }
+
+    bool Mumlib2::AudioSetOutputConfig(const AudioOutputConfig& config)
+    {
+        return impl->AudioSetOutputConfig(config);
+    }
+
+    bool Mumlib2::AudioOutputPop(AudioOutputFrame& frame)
+    {
+        return impl->AudioOutputPop(frame);
+    }
+
+    AudioOutputStats Mumlib2::AudioGetOutputStats()
+    {
+        return impl->AudioGetOutputStats();
+    }
+
     //
     // Channel
     //
@@ -36,14 +129,7 @@ namespace mumlib2 {
 
     std::string Mumlib2::ChannelCurrentGetName()
     {
-        auto current_id = ChannelCurrentGetId();
-        for (const auto& chan : impl->ChannelGetList()) {
-            if (chan.channelId == current_id) {
-                return chan.name;
-            }
-        }
-
-        return "";
+        return impl->ChannelGetCurrentName();
     }
 
     int32_t Mumlib2::ChannelCurrentGetId()
@@ -60,6 +146,21 @@ namespace mumlib2 {
         return ChannelJoin(id);
     }
 
+    std::optional<MumbleChannel> Mumlib2::ChannelGet(int32_t channel_id)
+    {
+        return impl->ChannelGet(channel_id);
+    }
+
+    std::vector<MumbleChannel> Mumlib2::ChannelGetChildren(int32_t channel_id)
+    {
+        return impl->ChannelGetChildren(channel_id);
+    }
+
+    int32_t Mumlib2::ChannelFind(const std::string& name_or_path)
+    {
+        return impl->ChannelFind(name_or_path);
+    }
+
     //
     // User
     //
@@ -96,6 +197,11 @@ namespace mumlib2 {
         return impl->UserMute(user_id, mute_state);
     }
 
+    bool Mumlib2::UserRequestBlob(int32_t user_id, UserField fields)
+    {
+        return impl->UserRequestBlob(user_id, fields);
+    }
+
     bool Mumlib2::UserMute(int32_t user_id, bool mute_state)
     {
         return impl->UserMute(user_id, mute_state);
@@ -105,6 +211,10 @@ namespace mumlib2 {
         return impl->TransportGetState();
     }
 
+    ConnectionStats Mumlib2::StatsGet() {
+        return impl->TransportGetStats();
+    }
+
     vector<MumbleUser> Mumlib2::getListAllUser() {
         return impl->UserGetList();
     }
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//mumlib
+#include "mumlib2/host.h"
+#include "mumlib2_private/mumlib2_host_private.h"
+
+namespace mumlib2 {
+
+    Mumlib2Host::Mumlib2Host(size_t thread_count) {
+        impl = std::make_unique<Mumlib2HostPrivate>(thread_count);
+    }
+
+    Mumlib2Host::~Mumlib2Host() = default;
+
+    size_t Mumlib2Host::ThreadCount() const
+    {
+        return impl->ThreadCount();
+    }
+
+    size_t Mumlib2Host::ConnectionCount() const
+    {
+        return impl->ClientCount();
+    }
+
+    //
+    // Stats
+    //
+    std::vector<ConnectionStats> Mumlib2Host::StatsGet() const
+    {
+        return impl->StatsGet();
+    }
+
+    HostStats Mumlib2Host::StatsGetAggregate() const
+    {
+        return impl->StatsGetAggregate();
+    }
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+
+//mumlib
+#include "mumlib2_private/mumlib2_host_private.h"
+#include "mumlib2_private/mumlib2_private.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor/Dtor
+    //
+
+    Mumlib2HostPrivate::Mumlib2HostPrivate(size_t thread_count) : _io_work(asio::make_work_guard(_io))
+    {
+        if (!thread_count) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        _threads.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++) {
+            _threads.emplace_back(&Mumlib2HostPrivate::threadRun, this);
+        }
+    }
+
+    Mumlib2HostPrivate::~Mumlib2HostPrivate()
+    {
+        _io_work.reset();
+        _io.stop();
+
+        for (auto& thread : _threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    asio::io_service& Mumlib2HostPrivate::IoService()
+    {
+        return _io;
+    }
+
+    void Mumlib2HostPrivate::threadRun()
+    {
+        while (true) {
+            try {
+                _io.run();
+                return;
+            }
+            catch (const std::exception& exp) {
+                //a failing connection must not take down the thread serving all others
+                _logger.log("Mumlib2::Mumlib2HostPrivate::threadRun() -> handler failed: ", exp.what());
+            }
+        }
+    }
+
+    //
+    // Clients
+    //
+
+    void Mumlib2HostPrivate::ClientAttach(Mumlib2Private* client)
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+        _clients.push_back(client);
+    }
+
+    void Mumlib2HostPrivate::ClientDetach(Mumlib2Private* client)
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+        std::erase(_clients, client);
+    }
+
+    size_t Mumlib2HostPrivate::ClientCount() const
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+        return _clients.size();
+    }
+
+    size_t Mumlib2HostPrivate::ThreadCount() const
+    {
+        return _threads.size();
+    }
+
+    //
+    // Stats
+    //
+
+    std::vector<ConnectionStats> Mumlib2HostPrivate::StatsGet() const
+    {
+        std::lock_guard<std::mutex> lock(_clients_mutex);
+
+        std::vector<ConnectionStats> result;
+        result.reserve(_clients.size());
+        for (const auto* client : _clients) {
+            result.push_back(client->TransportGetStats());
+        }
+        return result;
+    }
+
+    HostStats Mumlib2HostPrivate::StatsGetAggregate() const
+    {
+        HostStats result;
+        result.threads = static_cast<uint32_t>(ThreadCount());
+
+        for (const auto& stats : StatsGet()) {
+            result.connections++;
+            result.connected += stats.state == ConnectionState::CONNECTED;
+            result.udp_active += stats.udp_active;
+
+            result.total.tcp_messages += stats.tcp_messages;
+            result.total.tcp_rejected += stats.tcp_rejected;
+            result.total.tcp_queued_bytes += stats.tcp_queued_bytes;
+            result.total.udp_sent += stats.udp_sent;
+            result.total.udp_dropped += stats.udp_dropped;
+            result.total.udp_good += stats.udp_good;
+            result.total.udp_late += stats.udp_late;
+            result.total.udp_lost += stats.udp_lost;
+            result.total.udp_resync += stats.udp_resync;
+        }
+
+        return result;
+    }
+}
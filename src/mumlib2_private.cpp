@@ -7,12 +7,33 @@
 #include "mumlib2_private/mumlib2_private.h"
 
 namespace mumlib2 {
-	Mumlib2Private::Mumlib2Private(Callback& callback) : _callback(callback)
+	Mumlib2Private::Mumlib2Private(Callback& callback, Mumlib2HostPrivate* host) : _callback(callback), _host(host)
 	{
 		audioDecoderCreate(MUMBLE_AUDIO_SAMPLERATE);
         audioEncoderCreate(MUMBLE_AUDIO_SAMPLERATE, MUMBLE_OPUS_BITRATE);
+
+        if (_host) {
+            _host->ClientAttach(this);
+        }
+        else {
+            _transport_io = std::make_unique<asio::io_service>();
+        }
 	}
 
+    Mumlib2Private::~Mumlib2Private()
+    {
+        if (_audio_input) {
+            _audio_input->Stop();
+            _audio_input.reset();
+        }
+
+        TransportDisconnect();
+
+        if (_host) {
+            _host->ClientDetach(this);
+        }
+    }
+
     //
     // ACL
     //
@@ -49,15 +70,185 @@ namespace mumlib2 {
             return;
         }
 
+        //capture thread, the encoder runs on the input strand
+        if (_audio_input) {
+            _audio_input->Push(pcmData, static_cast<size_t>(pcmLength), _audio_channels.load(), target);
+            return;
+        }
+
+        audioEncode(pcmData, static_cast<size_t>(pcmLength), _audio_channels.load(), target);
+    }
+
+    void Mumlib2Private::audioEncode(const int16_t* pcmData, size_t pcmLength, uint32_t channels, uint32_t target)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+
         //check encoder availability
         if (!_audio_encoder) {
             return;
         }
 
-        //encode
-        auto packet = _audio_encoder->Encode(pcmData, pcmLength, target);
+        if (channels != _audio_profile.channels) {
+            //captured before the profile changed
+            return;
+        }
+
+        if (_audio_bitrate_maxbandwidth != _server_maxbandwidth) {
+            audioEncoderUpdateBitrate();
+        }
+
+        if (_audio_fec) {
+            audioEncoderUpdateLoss();
+        }
+
+        //encode and send
+        _audio_encoder->Encode(pcmData, pcmLength, target, _audio_tx_buffer, [this](std::span<const uint8_t> packet) { audioSendPacket(packet); });
+    }
+
+    void Mumlib2Private::AudioFlush(uint32_t target)
+    {
+        //queued behind the PCM sent so far
+        if (_audio_input) {
+            _audio_input->PushFlush(target);
+            return;
+        }
+
+        audioFlush(target);
+    }
+
+    void Mumlib2Private::audioFlush(uint32_t target)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+
+        //check encoder availability
+        if (!_audio_encoder) {
+            return;
+        }
+
+        _audio_encoder->Flush(target, _audio_tx_buffer, [this](std::span<const uint8_t> packet) { audioSendPacket(packet); });
+    }
+
+    bool Mumlib2Private::AudioSetInputConfig(const AudioInputConfig& config)
+    {
+        //the input is read on the transport strand without synchronization
+        if (TransportGetState() != ConnectionState::NOT_CONNECTED) {
+            return false;
+        }
+
+        if (_audio_input) {
+            _audio_input->Stop();
+            _audio_input.reset();
+        }
+
+        if (!config.enabled) {
+            return true;
+        }
+
+        uint32_t samplerate = MUMBLE_AUDIO_SAMPLERATE;
+        {
+            std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+            if (_audio_encoder) {
+                samplerate = _audio_encoder->GetInputSamplerate();
+            }
+        }
+
+        _audio_input = std::make_shared<AudioInput>(_host ? _host->IoService() : *_transport_io, config, samplerate,
+            [this](const AudioInputChunk& chunk) { audioInput(chunk); });
+        _audio_input->Start();
+        return true;
+    }
+
+    AudioInputStats Mumlib2Private::AudioGetInputStats() const
+    {
+        if (!_audio_input) {
+            return {};
+        }
+
+        return _audio_input->GetStats();
+    }
+
+    void Mumlib2Private::audioInput(const AudioInputChunk& chunk)
+    {
+        if (chunk.flush) {
+            audioFlush(chunk.target);
+            return;
+        }
+
+        audioEncode(chunk.pcm.data(), chunk.samples, chunk.channels, chunk.target);
+    }
+
+    void Mumlib2Private::AudioSetSamplerate(uint32_t input_samplerate, uint32_t output_samplerate, uint32_t quality)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+            if (_audio_encoder) {
+                _audio_encoder->SetInputSamplerate(input_samplerate, quality);
+            }
+        }
+
+        if (_audio_decoder) {
+            _audio_decoder->SetOutputSamplerate(output_samplerate, quality);
+        }
+    }
+
+    void Mumlib2Private::AudioSetFrameSize(uint32_t frame_ms, uint32_t frames_per_packet)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return;
+        }
+
+        _audio_encoder->SetFrameSize(frame_ms, frames_per_packet);
+        audioEncoderUpdateBitrate();
+    }
+
+    void Mumlib2Private::AudioSetEncoderProfile(const AudioEncoderProfile& profile)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return;
+        }
+
+        _audio_profile = profile;
+        _audio_channels = profile.channels;
+        _audio_encoder->SetProfile(profile);
+        audioEncoderUpdateBitrate();
+    }
+
+    AudioEncoderProfile Mumlib2Private::AudioGetEncoderProfile() const
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return _audio_profile;
+        }
+
+        return _audio_encoder->GetProfile();
+    }
+
+    void Mumlib2Private::audioEncoderUpdateBitrate()
+    {
+        //called with _audio_encoder_mutex held
+        //the server limit covers the packet overhead as well, it arrives with
+        //ServerConfig on the transport thread and is applied on the next send
+        uint32_t maxbandwidth = _server_maxbandwidth;
+        _audio_bitrate_maxbandwidth = maxbandwidth;
+
+        uint32_t bitrate = _audio_profile.bitrate;
+        if (maxbandwidth) {
+            uint32_t packets_per_second = 1000 / _audio_encoder->GetPacketDuration();
+            uint32_t overhead = _audio_packet_overhead * 8 * packets_per_second;
+
+            uint32_t limit = maxbandwidth > overhead ? maxbandwidth - overhead : 0;
+            bitrate = std::min(bitrate, std::max(limit, _audio_bitrate_min));
+        }
 
-        //send
+        if (bitrate != _audio_encoder->GetProfile().bitrate) {
+            _audio_encoder->SetBitrate(bitrate);
+        }
+    }
+
+    void Mumlib2Private::audioSendPacket(std::span<const uint8_t> packet)
+    {
         try {
             transportSendAudio(packet.data(), packet.size());
         }
@@ -66,12 +257,201 @@ namespace mumlib2 {
 
     void Mumlib2Private::audioDecoderCreate(uint32_t output_samplerate)
     {
-        _audio_decoder = std::make_unique<AudioDecoder>(MUMBLE_AUDIO_CHANNELS);
+        _audio_decoder = std::make_unique<AudioDecoder>(MUMBLE_AUDIO_CHANNELS, output_samplerate);
     }
 
     void Mumlib2Private::audioEncoderCreate(uint32_t input_samplerate, uint32_t output_bitrate)
     {
-        _audio_encoder = std::make_unique<AudioEncoder>(output_bitrate);
+        _audio_profile.bitrate = output_bitrate;
+        _audio_channels = _audio_profile.channels;
+        _audio_encoder = std::make_unique<AudioEncoder>(input_samplerate, _audio_profile);
+    }
+
+    void Mumlib2Private::AudioSetFec(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return;
+        }
+
+        _audio_encoder->SetFec(enabled);
+        _audio_encoder->SetPacketLoss(0);
+
+        _audio_fec = enabled;
+        _audio_loss_timestamp = {};
+    }
+
+    void Mumlib2Private::AudioSetVadConfig(const AudioVadConfig& config)
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return;
+        }
+
+        _audio_encoder->SetVadConfig(config);
+    }
+
+    AudioVadStats Mumlib2Private::AudioGetVadStats() const
+    {
+        std::lock_guard<std::mutex> lock(_audio_encoder_mutex);
+        if (!_audio_encoder) {
+            return {};
+        }
+
+        return _audio_encoder->GetVadStats();
+    }
+
+    void Mumlib2Private::audioEncoderUpdateLoss()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - _audio_loss_timestamp < _audio_loss_interval) {
+            return;
+        }
+        _audio_loss_timestamp = now;
+
+        //the loss seen on the downstream voice channel is taken as estimate for
+        //the upstream one; late packets count as lost, they miss their playout
+        auto stats = TransportGetStats();
+        uint32_t received = stats.udp_good + stats.udp_lost;
+        uint32_t missed = stats.udp_late + stats.udp_lost;
+
+        //counters restart with every key exchange
+        if (received < _audio_loss_received || missed < _audio_loss_missed) {
+            _audio_loss_received = 0;
+            _audio_loss_missed = 0;
+        }
+
+        uint32_t received_delta = received - _audio_loss_received;
+        uint32_t missed_delta = missed - _audio_loss_missed;
+        _audio_loss_received = received;
+        _audio_loss_missed = missed;
+
+        if (received_delta) {
+            _audio_encoder->SetPacketLoss(static_cast<uint32_t>(100ull * missed_delta / received_delta));
+        }
+    }
+
+    void Mumlib2Private::audioFrame(const AudioDecoderFrame& frame)
+    {
+        if (_audio_output) {
+            _audio_output->Push(frame);
+            if (!_audio_output->GetConfig().callback) {
+                return;
+            }
+        }
+
+        if (frame.is_concealed) {
+            _callback.audioConcealed(
+                frame.target,
+                frame.session_id,
+                frame.sequence_number,
+                frame.pcm,
+                frame.samples
+            );
+            return;
+        }
+
+        _callback.audio(
+            frame.target,
+            frame.session_id,
+            frame.sequence_number,
+            frame.is_last,
+            frame.pcm,
+            frame.samples
+        );
+    }
+
+    void Mumlib2Private::audioMixed(const AudioMixerFrame& frame)
+    {
+        if (_audio_output) {
+            _audio_output->Push(frame);
+            if (!_audio_output->GetConfig().callback) {
+                return;
+            }
+        }
+
+        _callback.audioMixed(
+            frame.channel_id,
+            frame.speakers,
+            frame.pcm,
+            frame.samples
+        );
+    }
+
+    void Mumlib2Private::audioMaintenance()
+    {
+        if (_audio_decoder) {
+            _audio_decoder->Evict();
+        }
+    }
+
+    bool Mumlib2Private::audioTick()
+    {
+        return _audio_decoder->Tick(
+            [this](const AudioDecoderFrame& frame) { audioFrame(frame); },
+            [this](const AudioMixerFrame& frame) { audioMixed(frame); }
+        );
+    }
+
+    void Mumlib2Private::AudioSetDecoderThreads(uint32_t threads)
+    {
+        _audio_decoder->SetWorkers(threads);
+    }
+
+    void Mumlib2Private::AudioSetJitterConfig(const JitterBufferConfig& config)
+    {
+        _audio_decoder->SetJitterConfig(config);
+    }
+
+    std::vector<JitterBufferStats> Mumlib2Private::AudioGetJitterStats() const
+    {
+        return _audio_decoder->GetJitterStats();
+    }
+
+    void Mumlib2Private::AudioSetMixerConfig(const AudioMixerConfig& config)
+    {
+        //speakers are mixed per channel they are in; the lookup runs on the
+        //transport strand, like the user state updates
+        _audio_decoder->SetMixerConfig(config, [this](int32_t session_id) {
+            return _state.UserChannel(session_id);
+        });
+    }
+
+    void Mumlib2Private::AudioSetSpeakerGain(int32_t session_id, float gain)
+    {
+        _audio_decoder->SetMixerGain(session_id, gain);
+    }
+
+    bool Mumlib2Private::AudioSetOutputConfig(const AudioOutputConfig& config)
+    {
+        //the queue is filled on the transport strand without synchronization
+        if (TransportGetState() != ConnectionState::NOT_CONNECTED) {
+            return false;
+        }
+
+        _audio_output.reset();
+        if (config.enabled) {
+            _audio_output = std::make_unique<AudioOutput>(config, MUMBLE_AUDIO_CHANNELS);
+        }
+        return true;
+    }
+
+    bool Mumlib2Private::AudioOutputPop(AudioOutputFrame& frame)
+    {
+        if (!_audio_output) {
+            return false;
+        }
+
+        return _audio_output->Pop(frame);
+    }
+
+    AudioOutputStats Mumlib2Private::AudioGetOutputStats() const
+    {
+        if (!_audio_output) {
+            return {};
+        }
+
+        return _audio_output->GetStats();
     }
 
     //
@@ -79,38 +459,50 @@ namespace mumlib2 {
     //
     uint32_t Mumlib2Private::ChannelGetCurrent() const
     {
-        return _channel_current;
+        return _state.Get()->channel_current;
     }
 
-    std::vector<MumbleChannel> Mumlib2Private::ChannelGetList() const
+    std::string Mumlib2Private::ChannelGetCurrentName() const
     {
-        return _channel_list;
+        auto state = _state.Get();
+        auto* channel = state->channels->Get(state->channel_current);
+        return channel ? channel->name : "";
     }
 
-    void Mumlib2Private::channelEmplace(MumbleChannel& channel)
+    std::optional<MumbleChannel> Mumlib2Private::ChannelGet(int32_t channel_id) const
     {
-        _channel_list.push_back(channel);
+        auto state = _state.Get();
+        if (auto* channel = state->channels->Get(channel_id)) {
+            return { *channel };
+        }
+
+        return {};
     }
 
-    bool Mumlib2Private::ChannelExists(uint32_t channel_id) const
+    std::vector<MumbleChannel> Mumlib2Private::ChannelGetChildren(int32_t channel_id) const
     {
-        for (auto& channel : _channel_list) {
-            if (channel.channelId == channel_id) {
-                return true;
-            }
+        auto state = _state.Get();
+
+        std::vector<MumbleChannel> result;
+        for (auto child : state->channels->GetChildren(channel_id)) {
+            result.push_back(*state->channels->Get(child));
         }
+        return result;
+    }
 
-        return false;
+    std::vector<MumbleChannel> Mumlib2Private::ChannelGetList() const
+    {
+        return _state.Get()->channels->GetList();
+    }
+
+    bool Mumlib2Private::ChannelExists(uint32_t channel_id) const
+    {
+        return _state.Get()->channels->Contains(channel_id);
     }
 
     void Mumlib2Private::channelErase(uint32_t channel_id)
     {
-        for (int i = 0; i < _channel_list.size(); i++) {
-            if (_channel_list[i].channelId == channel_id) {
-                _channel_list.erase(_channel_list.begin() + i);
-                return;
-            }
-        }
+        _state.ChannelErase(channel_id);
     }
 
     bool Mumlib2Private::ChannelJoin(uint32_t channel_id)
@@ -131,18 +523,17 @@ namespace mumlib2 {
 
     int32_t Mumlib2Private::ChannelFind(const std::string& channel_name) const
     {
-        for (auto& channel : _channel_list) {
-            if (channel.name == channel_name) {
-                return channel.channelId;
-            }
+        auto state = _state.Get();
+        if (channel_name.find('/') != std::string::npos) {
+            return state->channels->FindPath(channel_name);
         }
 
-        return -1;
+        return state->channels->Find(channel_name);
     }
 
     void Mumlib2Private::channelSet(uint32_t channel_id)
     {
-        _channel_current = channel_id;
+        _state.ChannelSet(channel_id);
     }
 
     //
@@ -152,10 +543,8 @@ namespace mumlib2 {
     {
         _session_id = 0;
 
-        _channel_current = 0;
-        _channel_list.clear();
-
-        userClear();
+        //users and channels
+        _state.Clear();
 
         _server_maxbandwidth = 0;
         _server_allowhtml = 0;
@@ -274,9 +663,7 @@ namespace mumlib2 {
         MumbleProto::ChannelRemove channelRemove;
         channelRemove.ParseFromArray(buffer, length);
 
-        if (ChannelExists(channelRemove.channel_id())) {
-            channelErase(channelRemove.channel_id());
-        }
+        channelErase(channelRemove.channel_id());
 
         _callback.channelRemove(channelRemove.channel_id());
         return true;
@@ -308,14 +695,31 @@ namespace mumlib2 {
             links_remove.push_back(channelState.links_remove(i));
         }
 
-        MumbleChannel mumbleChannel;
-        mumbleChannel.channelId = channel_id;
-        mumbleChannel.name = channelState.name();
-        mumbleChannel.description = channelState.description();
-
-        if (!ChannelExists(channel_id)) {
-            channelEmplace(mumbleChannel);
+        //update channel tree, only the fields present are changed
+        ChannelTreeUpdate update;
+        update.channel_id = channel_id;
+        if (channelState.has_parent()) {
+            update.parent = parent;
+        }
+        if (channelState.has_name()) {
+            update.name = channelState.name();
+        }
+        if (channelState.has_description()) {
+            update.description = channelState.description();
+        }
+        if (channelState.has_temporary()) {
+            update.temporary = temporary;
+        }
+        if (channelState.has_position()) {
+            update.position = position;
+        }
+        if (!links.empty()) {
+            update.links = links;
         }
+        update.links_add = links_add;
+        update.links_remove = links_remove;
+
+        _state.ChannelUpdate(update);
 
         _callback.channelState(
             channelState.name(),
@@ -411,8 +815,10 @@ namespace mumlib2 {
         int32_t actor = user_remove.has_actor() ? user_remove.actor() : -1;
         bool ban = user_remove.has_ban() && user_remove.ban(); //todo make sure it's correct to assume it's false
 
-        if (UserExists(user_remove.session())) {
-            userErase(user_remove.session());
+        userErase(user_remove.session());
+
+        if (_audio_decoder) {
+            _audio_decoder->Release(user_remove.session());
         }
 
         _callback.userRemove(
@@ -425,6 +831,18 @@ namespace mumlib2 {
         return true;
     }
 
+    static std::string blobHash(const std::string& blob)
+    {
+        //SHA1 of the content, as sent by the server for large comments and textures
+        if (blob.empty()) {
+            return "";
+        }
+
+        unsigned char digest[SHA_DIGEST_LENGTH]{};
+        SHA1(reinterpret_cast<const unsigned char*>(blob.data()), blob.size(), digest);
+        return std::string(reinterpret_cast<const char*>(digest), SHA_DIGEST_LENGTH);
+    }
+
     bool Mumlib2Private::processControlUserStatePacket(const uint8_t* buffer, int length)
     {
         MumbleProto::UserState userState;
@@ -443,19 +861,63 @@ namespace mumlib2 {
         int32_t priority_speaker = userState.has_priority_speaker() ? userState.priority_speaker() : -1;
         int32_t recording = userState.has_recording() ? userState.recording() : -1;
 
-        //update current channel
-        if (session == sessionGet()) {
-            channelSet(channel_id);
+        //update user list, only the fields present are changed
+        UserTableUpdate update;
+        update.session_id = session;
+        if (userState.has_name()) {
+            update.name = userState.name();
+        }
+        if (userState.has_channel_id()) {
+            update.channel_id = channel_id;
+        }
+        if (userState.has_user_id()) {
+            update.user_id = user_id;
+        }
+        if (userState.has_mute()) {
+            update.mute = userState.mute();
+        }
+        if (userState.has_deaf()) {
+            update.deaf = userState.deaf();
+        }
+        if (userState.has_suppress()) {
+            update.suppress = userState.suppress();
+        }
+        if (userState.has_self_mute()) {
+            update.self_mute = userState.self_mute();
+        }
+        if (userState.has_self_deaf()) {
+            update.self_deaf = userState.self_deaf();
+        }
+        if (userState.has_priority_speaker()) {
+            update.priority_speaker = userState.priority_speaker();
+        }
+        if (userState.has_recording()) {
+            update.recording = userState.recording();
+        }
+        if (userState.has_hash()) {
+            update.hash = userState.hash();
         }
 
+        //comment and texture are kept as hash only
+        if (userState.has_comment_hash()) {
+            update.comment_hash = userState.comment_hash();
+        }
+        else if (userState.has_comment()) {
+            update.comment_hash = blobHash(userState.comment());
+        }
+        if (userState.has_texture_hash()) {
+            update.texture_hash = userState.texture_hash();
+        }
+        else if (userState.has_texture()) {
+            update.texture_hash = blobHash(userState.texture());
+        }
 
-        //update user lsit
-        MumbleUser mumbleUser{};
-        mumbleUser.name = userState.name();
-        mumbleUser.channelId = channel_id;
-        mumbleUser.sessionId = session;
+        auto change = userUpdate(update);
 
-        userUpdate(mumbleUser);
+        //update current channel
+        if (change.user && session == sessionGet()) {
+            channelSet(change.user->channelId);
+        }
 
         _callback.userState(session,
             actor,
@@ -471,6 +933,22 @@ namespace mumlib2 {
             priority_speaker,
             recording);
 
+        if (change.fields != UserField::NONE) {
+            _callback.userChanged(*change.user, change.fields);
+        }
+
+        if ((change.fields & (UserField::CREATED | UserField::CHANNEL)) != UserField::NONE) {
+            _callback.userMoved(session, change.channel_from, change.user->channelId);
+        }
+
+        //content sent inline or as answer to UserRequestBlob()
+        if (session >= 0 && userState.has_comment()) {
+            _callback.userBlob(session, UserField::COMMENT, userState.comment());
+        }
+        if (session >= 0 && userState.has_texture()) {
+            _callback.userBlob(session, UserField::TEXTURE, userState.texture());
+        }
+
         return true;
     }
 
@@ -512,23 +990,17 @@ namespace mumlib2 {
         return true;
     }
 
-	bool Mumlib2Private::processAudioPacket(AudioPacket& packet)
+	bool Mumlib2Private::processAudioPacket(const AudioPacketView& packet)
 	{
         //check for mute
         if (UserMuted(packet.GetAudioSessionId())) {
-            return true;
+            return false;
         }
 
         if (packet.GetHeaderType() == AudioPacketType::Opus) {
-            auto [buf, len] = _audio_decoder->Process(packet);
-            _callback.audio(
-                packet.GetHeaderTarget(),
-                packet.GetAudioSessionId(),
-                packet.GetAudioSequenceNumber(),
-                packet.GetAudioLastFlag(),
-                buf,
-                len
-            );
+            //buffered packets are played out by audioTick(), the transport
+            //starts the tick; the sink may have disconnected it already
+            return _audio_decoder->Process(packet, [this](const AudioDecoderFrame& frame) { audioFrame(frame); });
         }
         else if (packet.GetHeaderType() == AudioPacketType::Ping) {
             //TODO: callback for ping
@@ -544,7 +1016,7 @@ namespace mumlib2 {
             );
         }
 
-        return true;
+        return false;
 	}
 
     //
@@ -553,8 +1025,9 @@ namespace mumlib2 {
 
     std::optional<MumbleUser> Mumlib2Private::UserGet(int32_t session_id)
     {
-        if (_user_map.contains(session_id)) {
-            return { _user_map[session_id] };
+        auto state = _state.Get();
+        if (auto* user = state->users->Get(session_id)) {
+            return { *user };
         }
         
         return {};
@@ -562,81 +1035,72 @@ namespace mumlib2 {
 
     std::vector<MumbleUser> Mumlib2Private::UserGetList() const
     {
-        std::vector<MumbleUser> result;
-        for (const auto& user : _user_map) {
-            result.push_back(user.second);
-        }
-        return result;
+        return _state.Get()->users->GetList();
     }
 
     std::vector<MumbleUser> Mumlib2Private::UserGetInChannel(int32_t channel_id) const
     {
+        auto state = _state.Get();
+
         std::vector<MumbleUser> result;
-        for (const auto& user : _user_map) {
-            if (user.second.channelId == channel_id) {
-                result.push_back(user.second);
-            }
+        for (auto session_id : state->users->GetInChannel(channel_id)) {
+            result.push_back(*state->users->Get(session_id));
         }
         return result;
     }
 
     bool Mumlib2Private::UserExists(uint32_t user_id) const
     {
-        return _user_map.contains(user_id);
+        return _state.Get()->users->Contains(user_id);
     }
 
-    bool Mumlib2Private::UserMuted(int32_t user_id)
+    bool Mumlib2Private::UserMuted(int32_t user_id) const
     {
-        if (!_user_map.contains(user_id)) {
-            return false;
-        }
-
-        return _user_map[user_id].local_mute;
+        return _state.IsMuted(user_id);
     }
 
-    void Mumlib2Private::userUpdate(MumbleUser& user)
+    UserTableChange Mumlib2Private::userUpdate(const UserTableUpdate& update)
     {
-        //name could be skipped on second trasmission
-        //local muted state must be copied
-        if (_user_map.contains(user.sessionId)) {
-            user.local_mute = _user_map[user.sessionId].local_mute;
-            user.name = _user_map[user.sessionId].name;
-        }
+        return _state.UserUpdate(update);
+    }
 
-        _user_map[user.sessionId] = user;
+    void Mumlib2Private::userErase(uint32_t user_id)
+    {
+        _state.UserErase(user_id);
     }
 
-    void Mumlib2Private::userClear()
+    int32_t Mumlib2Private::UserFind(const std::string& user_name) const
     {
-        _user_map.clear();
+        return _state.Get()->users->Find(user_name);
     }
 
-    void Mumlib2Private::userErase(uint32_t user_id)
+    bool Mumlib2Private::UserMute(int32_t user_id, bool mute_state)
     {
-        if (_user_map.contains(user_id)) {
-            _user_map.erase(user_id);
-        }
+        return _state.UserMute(user_id, mute_state);
     }
 
-    int32_t Mumlib2Private::UserFind(const std::string& user_name) const
+    bool Mumlib2Private::UserRequestBlob(int32_t user_id, UserField fields)
     {
-        for (auto& user : _user_map) {
-            if (user.second.name == user_name) {
-                return user.second.sessionId;
-            }
+        auto state = _state.Get();
+        auto* user = state->users->Get(user_id);
+        if (!user) {
+            return false;
         }
 
-        return -1;
-    }
+        //only content the server announced by hash has to be fetched
+        MumbleProto::RequestBlob requestBlob;
+        if ((fields & UserField::COMMENT) != UserField::NONE && !user->comment_hash.empty()) {
+            requestBlob.add_session_comment(user_id);
+        }
+        if ((fields & UserField::TEXTURE) != UserField::NONE && !user->texture_hash.empty()) {
+            requestBlob.add_session_texture(user_id);
+        }
 
-    bool Mumlib2Private::UserMute(int32_t user_id, bool mute_state)
-    {
-        if (!_user_map.contains(user_id)) {
+        if (!requestBlob.session_comment_size() && !requestBlob.session_texture_size()) {
             return false;
         }
 
-        _user_map[user_id].local_mute = mute_state;
-        return true;;
+        return transportSendControl(MessageType::REQUESTBLOB, requestBlob);
     }
 
     bool Mumlib2Private::UserSendState(UserState field, bool val)
@@ -752,25 +1216,31 @@ namespace mumlib2 {
 
         generalClear();
 
-		if (!_transport) {
+		if (!transportGet()) {
 			transportCreate();
 		}
-		_transport->connect(host, port, user, password);
+		transportGet()->connect(host, port, user, password);
         return true;
 	}
 
 	void Mumlib2Private::TransportDisconnect()
 	{
-		if (_transport) {
-			_transport->disconnect();
+		//may be called from a callback on the strand
+		if (auto transport = transportGet()) {
+			transport->disconnect();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_transport_mutex);
+			_transport.reset();
 		}
-		_transport.reset();
 
         generalClear();
 	}
 
 	ConnectionState Mumlib2Private::TransportGetState() const
 	{
+		std::lock_guard<std::mutex> lock(_transport_mutex);
 		if (!_transport) {
 			return ConnectionState::NOT_CONNECTED;
 		}
@@ -778,9 +1248,24 @@ namespace mumlib2 {
 		return _transport->getConnectionState();
 	}
 
+	ConnectionStats Mumlib2Private::TransportGetStats() const
+	{
+		std::lock_guard<std::mutex> lock(_transport_mutex);
+		if (!_transport) {
+			return {};
+		}
+
+		return _transport->getStats();
+	}
+
 	void Mumlib2Private::TransportRun()
 	{
-		_transport->run();
+		//hosted connections are driven by the host's threads
+		if (_host || !transportGet()) {
+			return;
+		}
+
+		_transport_io->run();
 	}
 
 	void Mumlib2Private::TransportSetCert(const std::string& cert)
@@ -795,41 +1280,61 @@ namespace mumlib2 {
 
 	void Mumlib2Private::transportCreate()
 	{
-		_transport = std::make_unique<Transport>(
+		if (!_host) {
+			//stopped by the previous disconnect
+			_transport_io->restart();
+		}
+
+		auto transport = std::make_shared<Transport>(
+			_host ? _host->IoService() : *_transport_io,
+			_host != nullptr,
 			std::bind(&Mumlib2Private::processControlPacket, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
 			std::bind(&Mumlib2Private::processAudioPacket, this, std::placeholders::_1),
+			std::bind(&Mumlib2Private::audioTick, this),
+			std::bind(&Mumlib2Private::audioMaintenance, this),
 			_transport_cert,
 			_transport_key);
+
+		std::lock_guard<std::mutex> lock(_transport_mutex);
+		_transport = std::move(transport);
 	}
 
+    std::shared_ptr<Transport> Mumlib2Private::transportGet() const
+    {
+        std::lock_guard<std::mutex> lock(_transport_mutex);
+        return _transport;
+    }
+
     bool Mumlib2Private::transportSendAuthentication(const std::vector<std::string>& tokens)
     {
-        if (!_transport) {
+        auto transport = transportGet();
+        if (!transport) {
             return false;
         }
 
-        _transport->sendAuthentication({ tokens });
+        transport->sendAuthentication({ tokens });
         return true;
     }
 
     bool Mumlib2Private::transportSendControl(MessageType type, google::protobuf::Message& message)
     {
-        if (!_transport) {
+        auto transport = transportGet();
+        if (!transport) {
             return false;
         }
 
-        _transport->sendControlMessage(type, message);
-        return true;
+        return transport->sendControlMessage(type, message);
     }
 
     bool Mumlib2Private::transportSendAudio(const uint8_t* data, size_t len)
     {
+        //called from the encoding thread, the socket and the crypt state belong to the strand
+        std::lock_guard<std::mutex> lock(_transport_mutex);
         if (!_transport) {
             return false;
         }
 
-        _transport->sendEncodedAudioPacket(data, len);
-        return true;
+        return _transport->postEncodedAudioPacket(std::span<const uint8_t>(data, len));
     }
 
     //
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//mumlib
+#include "mumlib2_private/state_store.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    StateStore::StateStore()
+    {
+        auto snapshot = std::make_shared<StateSnapshot>();
+        snapshot->users = std::make_shared<const UserTable>();
+        snapshot->channels = std::make_shared<const ChannelTree>();
+        _snapshot = std::move(snapshot);
+    }
+
+    //
+    // Readers
+    //
+
+    StateStore::Snapshot StateStore::Get() const
+    {
+        if (_working_dirty.load(std::memory_order_acquire)) {
+            publish();
+        }
+
+        std::lock_guard<std::mutex> lock(_snapshot_mutex);
+        return _snapshot;
+    }
+
+    bool StateStore::IsMuted(int32_t session_id) const
+    {
+        if (session_id >= 0 && session_id < _mute_indexed_max) {
+            auto word = _mute_bits[session_id / 64].load(std::memory_order_relaxed);
+            return (word >> (session_id % 64)) & 1;
+        }
+
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+        auto* user = _users.Get(session_id);
+        return user && user->local_mute;
+    }
+
+    int32_t StateStore::UserChannel(int32_t session_id) const
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        auto* user = _users.Get(session_id);
+        return user ? user->channelId : -1;
+    }
+
+    void StateStore::publish() const
+    {
+        std::lock_guard<std::mutex> writer_lock(_writer_mutex);
+        if (!_working_dirty.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        Snapshot previous;
+        {
+            std::lock_guard<std::mutex> lock(_snapshot_mutex);
+            previous = _snapshot;
+        }
+
+        //only the changed table is copied, its entries are shared with the working state
+        auto snapshot = std::make_shared<StateSnapshot>(*previous);
+        if (_users_changed) {
+            snapshot->users = std::make_shared<const UserTable>(_users);
+        }
+        if (_channels_changed) {
+            snapshot->channels = std::make_shared<const ChannelTree>(_channels);
+        }
+        snapshot->channel_current = _channel_current;
+
+        _users_changed = false;
+        _channels_changed = false;
+        _working_dirty.store(false, std::memory_order_relaxed);
+
+        //the previous snapshot is released outside of the lock
+        Snapshot published = std::move(snapshot);
+        {
+            std::lock_guard<std::mutex> lock(_snapshot_mutex);
+            _snapshot.swap(published);
+        }
+    }
+
+    //
+    // Writers
+    //
+
+    void StateStore::changed(bool users, bool channels)
+    {
+        //called with _writer_mutex held
+        _users_changed |= users;
+        _channels_changed |= channels;
+        _working_dirty.store(true, std::memory_order_release);
+    }
+
+    void StateStore::muteSet(int32_t session_id, bool mute_state)
+    {
+        if (session_id < 0 || session_id >= _mute_indexed_max) {
+            return;
+        }
+
+        uint64_t mask = uint64_t(1) << (session_id % 64);
+        if (mute_state) {
+            _mute_bits[session_id / 64].fetch_or(mask, std::memory_order_relaxed);
+        }
+        else {
+            _mute_bits[session_id / 64].fetch_and(~mask, std::memory_order_relaxed);
+        }
+    }
+
+    void StateStore::Clear()
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        _users.Clear();
+        _channels.Clear();
+        _channel_current = 0;
+        changed(true, true);
+
+        for (auto& word : _mute_bits) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void StateStore::ChannelUpdate(const ChannelTreeUpdate& channel)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        _channels.Update(channel);
+        changed(false, true);
+    }
+
+    void StateStore::ChannelErase(int32_t channel_id)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        if (_channels.Erase(channel_id)) {
+            changed(false, true);
+        }
+    }
+
+    void StateStore::ChannelSet(uint32_t channel_id)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        _channel_current = channel_id;
+        changed(false, false);
+    }
+
+    UserTableChange StateStore::UserUpdate(const UserTableUpdate& user)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        auto change = _users.Update(user);
+        if (change.fields != UserField::NONE) {
+            changed(true, false);
+        }
+        return change;
+    }
+
+    void StateStore::UserErase(int32_t session_id)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        if (_users.Erase(session_id)) {
+            changed(true, false);
+        }
+        muteSet(session_id, false);
+    }
+
+    bool StateStore::UserMute(int32_t session_id, bool mute_state)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        if (!_users.SetLocalMute(session_id, mute_state)) {
+            return false;
+        }
+
+        changed(true, false);
+        muteSet(session_id, mute_state);
+        return true;
+    }
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//mumlib
+#include "mumlib2_private/transport_udp_batch.h"
+
+#if defined(MUMLIB2_UDP_MMSG)
+
+//stdlib
+#include <algorithm>
+#include <cerrno>
+
+//linux
+#include <sys/uio.h>
+
+namespace mumlib2 {
+
+    //
+    // Receive
+    //
+
+    size_t TransportUdpBatch::Receive(int fd, std::error_code& ec)
+    {
+        std::array<mmsghdr, RecvBatchSize> msgs{};
+        std::array<iovec, RecvBatchSize> iovs{};
+
+        for (size_t i = 0; i < RecvBatchSize; i++) {
+            iovs[i].iov_base = _rx_buffers[i].data();
+            iovs[i].iov_len = _rx_buffers[i].size();
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int result;
+        do {
+            result = recvmmsg(fd, msgs.data(), RecvBatchSize, MSG_DONTWAIT, nullptr);
+        } while (result < 0 && errno == EINTR);
+
+        _stat_recv_syscalls.fetch_add(1, std::memory_order_relaxed);
+
+        if (result < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ec = std::error_code(errno, std::system_category());
+            }
+            return 0;
+        }
+
+        for (int i = 0; i < result; i++) {
+            _rx_lengths[i] = msgs[i].msg_len;
+        }
+
+        _stat_recv_datagrams.fetch_add(static_cast<uint64_t>(result), std::memory_order_relaxed);
+        return static_cast<size_t>(result);
+    }
+
+    std::span<const uint8_t> TransportUdpBatch::Datagram(size_t index) const
+    {
+        return std::span<const uint8_t>(_rx_buffers[index].data(), _rx_lengths[index]);
+    }
+
+    //
+    // Send
+    //
+
+    bool TransportUdpBatch::Queue(uint8_t* buffer, size_t length)
+    {
+        std::lock_guard<std::mutex> lock(_tx_mutex);
+
+        _tx_queue.emplace_back(buffer, length);
+        if (_tx_scheduled) {
+            return false;
+        }
+
+        _tx_scheduled = true;
+        return true;
+    }
+
+    bool TransportUdpBatch::Flush(int fd, const sockaddr* addr, socklen_t addrlen, TransportUdpPool& pool, std::error_code& ec)
+    {
+        std::array<std::pair<uint8_t*, size_t>, SendBatchSize> batch;
+        std::array<mmsghdr, SendBatchSize> msgs{};
+        std::array<iovec, SendBatchSize> iovs{};
+
+        while (true) {
+            size_t count;
+            {
+                std::lock_guard<std::mutex> lock(_tx_mutex);
+
+                if (_tx_queue.empty()) {
+                    _tx_scheduled = false;
+                    return true;
+                }
+
+                count = std::min(_tx_queue.size(), SendBatchSize);
+                std::copy_n(_tx_queue.begin(), count, batch.begin());
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                iovs[i].iov_base = batch[i].first;
+                iovs[i].iov_len = batch[i].second;
+                msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(addr);
+                msgs[i].msg_hdr.msg_namelen = addrlen;
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            int result;
+            do {
+                result = sendmmsg(fd, msgs.data(), static_cast<unsigned int>(count), MSG_DONTWAIT);
+            } while (result < 0 && errno == EINTR);
+
+            _stat_send_syscalls.fetch_add(1, std::memory_order_relaxed);
+
+            if (result < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    //still scheduled, the caller waits for writability
+                    return false;
+                }
+
+                ec = std::error_code(errno, std::system_category());
+                Clear(pool);
+                return false;
+            }
+
+            auto sent = static_cast<size_t>(result);
+            _stat_send_datagrams.fetch_add(sent, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(_tx_mutex);
+                _tx_queue.erase(_tx_queue.begin(), _tx_queue.begin() + sent);
+            }
+
+            for (size_t i = 0; i < sent; i++) {
+                pool.Release(batch[i].first);
+            }
+        }
+    }
+
+    void TransportUdpBatch::Clear(TransportUdpPool& pool)
+    {
+        std::lock_guard<std::mutex> lock(_tx_mutex);
+
+        for (auto& entry : _tx_queue) {
+            pool.Release(entry.first);
+        }
+        _tx_queue.clear();
+        _tx_scheduled = false;
+    }
+
+    //
+    // Stats
+    //
+
+    UdpBatchStats TransportUdpBatch::GetStats() const
+    {
+        UdpBatchStats stats;
+        stats.recv_syscalls = _stat_recv_syscalls.load(std::memory_order_relaxed);
+        stats.recv_datagrams = _stat_recv_datagrams.load(std::memory_order_relaxed);
+        stats.send_syscalls = _stat_send_syscalls.load(std::memory_order_relaxed);
+        stats.send_datagrams = _stat_send_datagrams.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
+
+#endif
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <bit>
+
+//mumlib
+#include "mumlib2_private/transport_udp_pool.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    TransportUdpPool::TransportUdpPool(UdpPoolFallback fallback)
+        : _free_mask(SlotCount == 64 ? ~uint64_t(0) : (uint64_t(1) << SlotCount) - 1),
+          _fallback(fallback)
+    {
+    }
+
+    //
+    // Slots
+    //
+
+    uint8_t* TransportUdpPool::Acquire()
+    {
+        uint64_t mask = _free_mask.load(std::memory_order_relaxed);
+        while (mask) {
+            auto idx = std::countr_zero(mask);
+            if (_free_mask.compare_exchange_weak(mask, mask & ~(uint64_t(1) << idx), std::memory_order_acquire, std::memory_order_relaxed)) {
+                _stat_acquired.fetch_add(1, std::memory_order_relaxed);
+
+                auto in_use = _stat_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+                auto peak = _stat_in_use_peak.load(std::memory_order_relaxed);
+                while (in_use > peak && !_stat_in_use_peak.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {
+                }
+
+                return _slots[idx].data();
+            }
+        }
+
+        //exhausted
+        _stat_exhausted.fetch_add(1, std::memory_order_relaxed);
+        if (_fallback.load(std::memory_order_relaxed) == UdpPoolFallback::DROP) {
+            _stat_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        _stat_fallback_allocated.fetch_add(1, std::memory_order_relaxed);
+        return new uint8_t[SlotSize];
+    }
+
+    void TransportUdpPool::Release(uint8_t* buffer)
+    {
+        if (!buffer) {
+            return;
+        }
+
+        if (!owns(buffer)) {
+            delete[] buffer;
+            return;
+        }
+
+        auto idx = static_cast<size_t>(buffer - _slots[0].data()) / SlotSize;
+        _free_mask.fetch_or(uint64_t(1) << idx, std::memory_order_release);
+        _stat_in_use.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool TransportUdpPool::owns(const uint8_t* buffer) const
+    {
+        auto begin = reinterpret_cast<uintptr_t>(_slots.data());
+        auto end = begin + sizeof(_slots);
+        auto ptr = reinterpret_cast<uintptr_t>(buffer);
+        return ptr >= begin && ptr < end;
+    }
+
+    //
+    // Settings/Stats
+    //
+
+    void TransportUdpPool::SetFallback(UdpPoolFallback fallback)
+    {
+        _fallback.store(fallback, std::memory_order_relaxed);
+    }
+
+    UdpPoolStats TransportUdpPool::GetStats() const
+    {
+        UdpPoolStats stats;
+        stats.acquired = _stat_acquired.load(std::memory_order_relaxed);
+        stats.exhausted = _stat_exhausted.load(std::memory_order_relaxed);
+        stats.fallback_allocated = _stat_fallback_allocated.load(std::memory_order_relaxed);
+        stats.dropped = _stat_dropped.load(std::memory_order_relaxed);
+        stats.in_use = _stat_in_use.load(std::memory_order_relaxed);
+        stats.in_use_peak = _stat_in_use_peak.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
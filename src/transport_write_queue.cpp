@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+#include <cstring>
+
+//mumlib
+#include "mumlib2_private/transport_write_queue.h"
+
+namespace mumlib2 {
+
+    //
+    // Ctor
+    //
+
+    TransportWriteQueue::TransportWriteQueue(size_t highwater) : _highwater(highwater)
+    {
+        _pending.reserve(_free_chunks_max);
+        _inflight.reserve(_free_chunks_max);
+        _free.reserve(_free_chunks_max);
+    }
+
+    //
+    // Producer
+    //
+
+    bool TransportWriteQueue::Push(const uint8_t* data, size_t length, bool droppable)
+    {
+        if (!data) {
+            return false;
+        }
+
+        return Emplace(length, droppable, [data, length](uint8_t* out) {
+            std::memcpy(out, data, length);
+        });
+    }
+
+    uint8_t* TransportWriteQueue::reserve(size_t length, bool droppable)
+    {
+        if (!length) {
+            return nullptr;
+        }
+
+        auto limit = droppable ? _highwater / 2 : _highwater;
+        if (_queued + length > limit) {
+            _stats.rejected++;
+            return nullptr;
+        }
+
+        auto& chunk = chunkFor(length);
+        uint8_t* out = chunk.data.get() + chunk.size;
+        chunk.size += length;
+
+        _queued += length;
+        _stats.messages++;
+        _stats.queued_bytes_peak = std::max(_stats.queued_bytes_peak, _queued);
+        return out;
+    }
+
+    TransportWriteQueue::Chunk& TransportWriteQueue::chunkFor(size_t length)
+    {
+        //coalesce with the previous message if it still fits
+        if (!_pending.empty()) {
+            auto& last = _pending.back();
+            if (last.capacity - last.size >= length) {
+                _stats.coalesced++;
+                return last;
+            }
+        }
+
+        //reuse a released chunk
+        if (!_free.empty()) {
+            _pending.push_back(std::move(_free.back()));
+            _free.pop_back();
+        }
+        else {
+            _pending.emplace_back();
+        }
+
+        auto& chunk = _pending.back();
+        if (chunk.capacity < length) {
+            chunk.capacity = std::max(ChunkSize, length);
+            chunk.data = std::make_unique_for_overwrite<uint8_t[]>(chunk.capacity);
+        }
+        return chunk;
+    }
+
+    //
+    // Consumer
+    //
+
+    bool TransportWriteQueue::BeginWrite(std::vector<asio::const_buffer>& buffers)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_writing || _pending.empty()) {
+            return false;
+        }
+
+        _inflight.swap(_pending);
+
+        buffers.clear();
+        for (const auto& chunk : _inflight) {
+            buffers.emplace_back(chunk.data.get(), chunk.size);
+        }
+
+        _writing = true;
+        _stats.writes++;
+        return true;
+    }
+
+    void TransportWriteQueue::EndWrite()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto& chunk : _inflight) {
+            _queued -= chunk.size;
+            if (_free.size() < _free_chunks_max) {
+                chunk.size = 0;
+                _free.push_back(std::move(chunk));
+            }
+        }
+        _inflight.clear();
+
+        _writing = false;
+    }
+
+    void TransportWriteQueue::Clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        //in-flight chunks are still referenced by the pending write and are released in EndWrite()
+        for (auto& chunk : _pending) {
+            _queued -= chunk.size;
+        }
+        _pending.clear();
+    }
+
+    //
+    // Settings/Stats
+    //
+
+    void TransportWriteQueue::SetHighwater(size_t highwater)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _highwater = highwater;
+    }
+
+    size_t TransportWriteQueue::Size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queued;
+    }
+
+    WriteQueueStats TransportWriteQueue::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto stats = _stats;
+        stats.queued_bytes = _queued;
+        return stats;
+    }
+}
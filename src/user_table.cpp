@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright (c) 2015-2022 mumlib2 contributors
+
+//stdlib
+#include <algorithm>
+
+//mumlib
+#include "mumlib2_private/user_table.h"
+
+namespace mumlib2 {
+
+    //
+    // Lookup
+    //
+
+    const MumbleUser* UserTable::Get(int32_t session_id) const
+    {
+        auto it = _users.find(session_id);
+        return it != _users.end() ? it->second.get() : nullptr;
+    }
+
+    bool UserTable::Contains(int32_t session_id) const
+    {
+        return _users.contains(session_id);
+    }
+
+    size_t UserTable::Size() const
+    {
+        return _users.size();
+    }
+
+    int32_t UserTable::Find(const std::string& name) const
+    {
+        auto it = _names.find(name);
+        return it != _names.end() ? it->second : -1;
+    }
+
+    std::span<const int32_t> UserTable::GetInChannel(int32_t channel_id) const
+    {
+        auto it = _channels.find(channel_id);
+        if (it == _channels.end()) {
+            return {};
+        }
+        return it->second;
+    }
+
+    std::vector<MumbleUser> UserTable::GetList() const
+    {
+        std::vector<MumbleUser> result;
+        result.reserve(_users.size());
+        for (const auto& user : _users) {
+            result.push_back(*user.second);
+        }
+
+        std::sort(result.begin(), result.end(), [](const MumbleUser& a, const MumbleUser& b) { return a.sessionId < b.sessionId; });
+        return result;
+    }
+
+    //
+    // Modification
+    //
+
+    template<typename T, typename U>
+    static void userFieldDiff(UserField& fields, UserField field, const std::optional<T>& value, const U& current)
+    {
+        if (value && *value != current) {
+            fields |= field;
+        }
+    }
+
+    template<typename T, typename U>
+    static void userFieldApply(const std::optional<T>& value, U& current)
+    {
+        if (value) {
+            current = *value;
+        }
+    }
+
+    UserTableChange UserTable::Update(const UserTableUpdate& update)
+    {
+        auto session_id = update.session_id;
+        if (session_id < 0) {
+            return {};
+        }
+
+        //new users without a channel are in the root channel
+        auto* known = Get(session_id);
+        MumbleUser created;
+        created.sessionId = session_id;
+        created.channelId = 0;
+        const auto& current = known ? *known : created;
+
+        //compare first, unchanged entries are not cloned
+        UserField fields = known ? UserField::NONE : UserField::CREATED;
+        userFieldDiff(fields, UserField::NAME, update.name, current.name);
+        userFieldDiff(fields, UserField::CHANNEL, update.channel_id, current.channelId);
+        userFieldDiff(fields, UserField::USER_ID, update.user_id, current.userId);
+        userFieldDiff(fields, UserField::MUTE, update.mute, current.mute);
+        userFieldDiff(fields, UserField::DEAF, update.deaf, current.deaf);
+        userFieldDiff(fields, UserField::SUPPRESS, update.suppress, current.suppress);
+        userFieldDiff(fields, UserField::SELF_MUTE, update.self_mute, current.self_mute);
+        userFieldDiff(fields, UserField::SELF_DEAF, update.self_deaf, current.self_deaf);
+        userFieldDiff(fields, UserField::PRIORITY_SPEAKER, update.priority_speaker, current.priority_speaker);
+        userFieldDiff(fields, UserField::RECORDING, update.recording, current.recording);
+        userFieldDiff(fields, UserField::HASH, update.hash, current.hash);
+        userFieldDiff(fields, UserField::COMMENT, update.comment_hash, current.comment_hash);
+        userFieldDiff(fields, UserField::TEXTURE, update.texture_hash, current.texture_hash);
+
+        UserTableChange change;
+        change.fields = fields;
+        change.channel_from = known ? known->channelId : -1;
+        if (fields == UserField::NONE) {
+            change.user = _users.at(session_id);
+            return change;
+        }
+
+        if (!known) {
+            _users.emplace(session_id, std::make_shared<MumbleUser>(created));
+        }
+        else {
+            nameRemove(known->name, session_id);
+            channelRemove(known->channelId, session_id);
+        }
+
+        auto& user = mutate(session_id);
+        userFieldApply(update.name, user.name);
+        userFieldApply(update.channel_id, user.channelId);
+        userFieldApply(update.user_id, user.userId);
+        userFieldApply(update.mute, user.mute);
+        userFieldApply(update.deaf, user.deaf);
+        userFieldApply(update.suppress, user.suppress);
+        userFieldApply(update.self_mute, user.self_mute);
+        userFieldApply(update.self_deaf, user.self_deaf);
+        userFieldApply(update.priority_speaker, user.priority_speaker);
+        userFieldApply(update.recording, user.recording);
+        userFieldApply(update.hash, user.hash);
+        userFieldApply(update.comment_hash, user.comment_hash);
+        userFieldApply(update.texture_hash, user.texture_hash);
+
+        nameSet(user.name, session_id);
+        channelAdd(user.channelId, session_id);
+
+        change.user = _users.at(session_id);
+        return change;
+    }
+
+    bool UserTable::Erase(int32_t session_id)
+    {
+        auto it = _users.find(session_id);
+        if (it == _users.end()) {
+            return false;
+        }
+
+        nameRemove(it->second->name, session_id);
+        channelRemove(it->second->channelId, session_id);
+        _users.erase(it);
+        return true;
+    }
+
+    void UserTable::Clear()
+    {
+        _users.clear();
+        _names.clear();
+        _channels.clear();
+    }
+
+    bool UserTable::SetLocalMute(int32_t session_id, bool mute_state)
+    {
+        if (!Contains(session_id)) {
+            return false;
+        }
+
+        mutate(session_id).local_mute = mute_state;
+        return true;
+    }
+
+    MumbleUser& UserTable::mutate(int32_t session_id)
+    {
+        //clone entries shared with a copy of the table
+        auto& user = _users.at(session_id);
+        if (user.use_count() > 1) {
+            user = std::make_shared<MumbleUser>(*user);
+        }
+        return *user;
+    }
+
+    void UserTable::channelAdd(int32_t channel_id, int32_t session_id)
+    {
+        if (channel_id >= 0) {
+            _channels[channel_id].push_back(session_id);
+        }
+    }
+
+    void UserTable::channelRemove(int32_t channel_id, int32_t session_id)
+    {
+        auto it = _channels.find(channel_id);
+        if (it == _channels.end()) {
+            return;
+        }
+
+        std::erase(it->second, session_id);
+        if (it->second.empty()) {
+            _channels.erase(it);
+        }
+    }
+
+    void UserTable::nameSet(const std::string& name, int32_t session_id)
+    {
+        if (!name.empty()) {
+            _names[name] = session_id;
+        }
+    }
+
+    void UserTable::nameRemove(const std::string& name, int32_t session_id)
+    {
+        auto it = _names.find(name);
+        if (it != _names.end() && it->second == session_id) {
+            _names.erase(it);
+        }
+    }
+}